@@ -5,17 +5,36 @@
 #include <ctype.h>
 #include "playerErrors.h"
 #include "2310X.h"
+#include "2310plugin.h"
+#include "2310profile.h"
 
 /* Takes in the game representation and this player's representation.
  * Calculates the appropriate next move to make based on the Player A
  * strategy. Returns the site number of the next move to be made. */
 int calculate_type_a_move(Game* game, Player* thisPlayer);
 
+#ifdef STRATEGY_PLUGIN
+/* Player A strategy, for the dealer to load in-process (see 2310plugin.h) */
+const StrategyPlugin strategy_plugin = {
+    .abiVersion = STRATEGY_PLUGIN_ABI_VERSION,
+    .name = "2310A",
+    .init = NULL,
+    .moveStrategy = calculate_type_a_move,
+    .teardown = NULL
+};
+#else
 int main(int argc, char** argv) {
     // Set following to NULL, will be populated in setup_player()
     char* path = NULL;
     Game* game = NULL;
     Player* thisPlayer = NULL;
+    start_sampling_profiler(); // Only if asked to, see 2310profile.h
+
+    // A zygote only goes on to play in the players it forks
+    if (argc == 2 && !strcmp(argv[1], ZYGOTE_MODE_ARG) &&
+	    !serve_fork_requests(&argc, &argv)) {
+	return PLAYER_NORMAL;
+    }
 
     PlayerExitCodes playerError = setup_player(argc, argv, &game, &thisPlayer,
 	    &path);
@@ -25,9 +44,16 @@ int main(int argc, char** argv) {
     }
 
     playerError = play_game(game, thisPlayer, calculate_type_a_move);
+
+    // Pooled players go on to play any further games the dealer starts
+    while (playerError == PLAYER_NORMAL && next_game(&game, &thisPlayer,
+	    &path, &playerError)) {
+	playerError = play_game(game, thisPlayer, calculate_type_a_move);
+    }
     free_game(game, path);
     return player_error_message(playerError);
 }
+#endif
 
 int calculate_type_a_move(Game* game, Player* thisPlayer) {
     int nextSite = thisPlayer->currentSite + 1;
@@ -40,21 +66,21 @@ int calculate_type_a_move(Game* game, Player* thisPlayer) {
     }
 
     // If next site is Mo, go there (ensure site is not full)
-    if (get_site_type(game->path->sites[nextSite].type) == SITE_MO &&
+    if (game->path->sites[nextSite].siteType == SITE_MO &&
 	    !check_site_full(game, nextSite)) {
 	return nextSite;
     }
 
     // Go to the nearest V1, V2, or barrier site (::) (ensure site is not full
     // and no barriers are skipped)
-    for (int site = nextSite; site < game->path->numSites; site++) {
-	SiteType siteToMoveTo = get_site_type(game->path->sites[site].type);
-	if ((siteToMoveTo == SITE_V1 || siteToMoveTo == SITE_V2 ||
-		siteToMoveTo == SITE_BARRIER) &&
-		!check_site_full(game, site) &&
-		!check_barrier_skipped(game, thisPlayer, site)) {
-	    return site;
+    SiteType sitesToVisit[] = {SITE_V1, SITE_V2, SITE_BARRIER};
+    int nearestSite = INVALID_SITE; // Should never remain invalid
+    for (int i = 0; i < sizeof(sitesToVisit) / sizeof(SiteType); i++) {
+	int site = get_first_site_of_type(sitesToVisit[i], thisPlayer, game);
+	if (site != INVALID_SITE &&
+		(nearestSite == INVALID_SITE || site < nearestSite)) {
+	    nearestSite = site;
 	}
     }
-    return INVALID_SITE; // Should never reach here, something went wrong
+    return nearestSite;
 }
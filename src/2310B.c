@@ -5,6 +5,8 @@
 #include <ctype.h>
 #include "playerErrors.h"
 #include "2310X.h"
+#include "2310plugin.h"
+#include "2310profile.h"
 
 /* Takes in the game representation and this player's representation.
  * Calculates the appropriate next move to make based on the Player B
@@ -13,14 +15,32 @@ int calculate_type_b_move(Game* game, Player* thisPlayer);
 
 /* Takes in the game representation. Returns the player ID of the player who
  * has the most cards. If all players have zero cards, returns the player
- * count. Otherwise, returns INVALID_PLAYER_ID. */
+ * count. Otherwise, returns INVALID_PLAYER_ID. Uses the card count trackers
+ * of the game representation, so takes constant time. */
 int calculate_player_with_max_cards(Game* game);
 
+#ifdef STRATEGY_PLUGIN
+/* Player B strategy, for the dealer to load in-process (see 2310plugin.h) */
+const StrategyPlugin strategy_plugin = {
+    .abiVersion = STRATEGY_PLUGIN_ABI_VERSION,
+    .name = "2310B",
+    .init = NULL,
+    .moveStrategy = calculate_type_b_move,
+    .teardown = NULL
+};
+#else
 int main(int argc, char** argv) {
     // Set following to NULL, will be populated in setup_player()
     char* path = NULL;
     Game* game = NULL;
     Player* thisPlayer = NULL;
+    start_sampling_profiler(); // Only if asked to, see 2310profile.h
+
+    // A zygote only goes on to play in the players it forks
+    if (argc == 2 && !strcmp(argv[1], ZYGOTE_MODE_ARG) &&
+	    !serve_fork_requests(&argc, &argv)) {
+	return PLAYER_NORMAL;
+    }
 
     PlayerExitCodes playerError = setup_player(argc, argv, &game, &thisPlayer,
 	    &path);
@@ -30,23 +50,22 @@ int main(int argc, char** argv) {
     }
 
     playerError = play_game(game, thisPlayer, calculate_type_b_move);
+
+    // Pooled players go on to play any further games the dealer starts
+    while (playerError == PLAYER_NORMAL && next_game(&game, &thisPlayer,
+	    &path, &playerError)) {
+	playerError = play_game(game, thisPlayer, calculate_type_b_move);
+    }
     free_game(game, path);
     return player_error_message(playerError);
 }
+#endif
 
 int calculate_type_b_move(Game* game, Player* thisPlayer) {
     int nextSite = thisPlayer->currentSite + 1;
-    // Ensure all players are in front of thisPlayer
-    int player = 0;
-    for (; player < game->playerCount; player++) {
-	if (game->players[player]->currentSite <= thisPlayer->currentSite &&
-		player != thisPlayer->playerID) {
-	    break;
-	}
-    }
-    // If loop completed normally (i.e. break was never called), then all
-    // players are in front of thisPlayer
-    if (player == game->playerCount && !check_site_full(game, nextSite)) {
+    // If all players are in front of thisPlayer, move forward one site
+    if (is_behind_all_others(game, thisPlayer) &&
+	    !check_site_full(game, nextSite)) {
 	return nextSite;
     }
 
@@ -81,32 +100,11 @@ int calculate_type_b_move(Game* game, Player* thisPlayer) {
 }
 
 int calculate_player_with_max_cards(Game* game) {
-    int mostCards = 0;
-    int playerWithMostCards = INVALID_PLAYER_ID;
-    bool tieForMax = false; // Flag to ensure player has strict max # of cards
-
-    for (int player = 0; player < game->playerCount; player++) {
-	int numCardsOfPlayer = 0;
-	for (int cardType = 0; cardType < NUM_CARD_TYPES; cardType++) {
-	    numCardsOfPlayer += game->players[player]->numCards[cardType];
-	}
-	if (numCardsOfPlayer > mostCards) {
-	    mostCards = numCardsOfPlayer;
-	    playerWithMostCards = player;
-	    tieForMax = false;
-	} else if (numCardsOfPlayer == mostCards) {
-	    tieForMax = true;
-	}
-    }
-    
     // If all players have 0 cards, return the player count as a sentinel
-    // Otherwise, if no player has a strict maximum number of cards, return
-    // INVALID_PLAYER_ID as a sentinel
-    if (!mostCards && tieForMax) {
-	playerWithMostCards = game->playerCount;
-    } else if (tieForMax) {
-	playerWithMostCards = INVALID_PLAYER_ID;
+    // Otherwise, if no player has a strict maximum number of cards, the card
+    // leader is INVALID_PLAYER_ID, which acts as a sentinel
+    if (!game->mostCards) {
+	return game->playerCount;
     }
-
-    return playerWithMostCards;
+    return game->cardLeader;
 }
@@ -3,6 +3,11 @@
 #include <string.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
 #include "playerErrors.h"
 #include "dealerErrors.h"
 #include "2310X.h"
@@ -32,7 +37,16 @@ PlayerExitCodes setup_player(int argc, char** argv, Game** game,
 	    strtol_invalid(thisPlayerIDInput, thisPlayerIDErrors)) {
 	return player_error_message(PLAYER_ID);
     }
+    PlayerExitCodes pathError = start_player_game(playerCount, thisPlayerID,
+	    game, thisPlayer, path);
+    if (pathError != PLAYER_NORMAL) {
+	return player_error_message(pathError);
+    }
+    return PLAYER_NORMAL;
+}
 
+PlayerExitCodes start_player_game(int playerCount, int thisPlayerID,
+	Game** game, Player** thisPlayer, char** path) {
     printf("^");
     fflush(stdout);
  
@@ -48,18 +62,173 @@ PlayerExitCodes setup_player(int argc, char** argv, Game** game,
 
     if (pathError != PLAYER_NORMAL) {
 	free(*path);
-	return player_error_message(pathError);
+	return pathError;
     }
 
     // Set up game data structures
     *game = init_game(*path, playerCount);
     *thisPlayer = (*game)->players[thisPlayerID];
+
+    // The dealer discards player stderr, in which case there is no point
+    // rendering the game display. Run the player with stderr elsewhere (e.g.
+    // a terminal) to see the full display when debugging.
+    (*game)->displayEnabled = !stderr_discarded();
     return PLAYER_NORMAL;
 }
 
+bool next_game(Game** game, Player** thisPlayer, char** path,
+	PlayerExitCodes* playerError) {
+    // Only pooled players play more than one game
+    if (!getenv(PERSISTENT_PLAYER_ENV)) {
+	return false;
+    }
+    size_t dealerMessageMax = INITIAL_BUFFER_SIZE;
+    char* dealerMessage = (char*)malloc(dealerMessageMax * sizeof(char));
+    get_line(&dealerMessage, &dealerMessageMax, stdin);
+
+    // The dealer closing the pipe means there are no more games
+    if (!strlen(dealerMessage)) {
+	free(dealerMessage);
+	return false;
+    }
+    // NEWGAME is 7 chars, followed by the player count and this player's ID,
+    // as would otherwise be given on the command line
+    char* playerCountErrors = NULL;
+    char* thisPlayerIDErrors = NULL;
+    int playerCount = 0;
+    int thisPlayerID = INVALID_PLAYER_ID;
+    if (!strncmp(dealerMessage, "NEWGAME", 7)) {
+	playerCount = strtol(dealerMessage + 7, &playerCountErrors, 10);
+	if (*playerCountErrors == ',') {
+	    thisPlayerID = strtol(playerCountErrors + 1, &thisPlayerIDErrors,
+		    10);
+	}
+    }
+    if (playerCount < 1 || thisPlayerID < 0 || thisPlayerID >= playerCount ||
+	    strtol_invalid(playerCountErrors + 1, thisPlayerIDErrors)) {
+	free(dealerMessage);
+	*playerError = PLAYER_COMMUNICATION;
+	return false;
+    }
+    free(dealerMessage);
+
+    Game* newGame = NULL;
+    Player* newPlayer = NULL;
+    char* newPath = NULL;
+    *playerError = start_player_game(playerCount, thisPlayerID, &newGame,
+	    &newPlayer, &newPath);
+    if (*playerError != PLAYER_NORMAL) {
+	return false;
+    }
+    // Replace the finished game
+    free_game(*game, *path);
+    *game = newGame;
+    *thisPlayer = newPlayer;
+    *path = newPath;
+    return true;
+}
+
+bool serve_fork_requests(int* argc, char*** argv) {
+    // Forked players are reaped automatically, as the dealer cannot
+    signal(SIGCHLD, SIG_IGN);
+    static char playerCountArg[INITIAL_BUFFER_SIZE];
+    static char* playerArgs[NUM_COMMAND_LINE_ARGS + 1];
+    while (true) {
+	// Each request is one packet: "c,i" with the game pipes attached
+	char request[INITIAL_BUFFER_SIZE];
+	char control[CMSG_SPACE(2 * sizeof(int))];
+	struct iovec requestData = {.iov_base = request,
+		.iov_len = INITIAL_BUFFER_SIZE - 1};
+	struct msghdr requestMessage = {.msg_iov = &requestData,
+		.msg_iovlen = 1, .msg_control = control,
+		.msg_controllen = sizeof(control)};
+	ssize_t requestLength = recvmsg(STDIN_FILENO, &requestMessage,
+		MSG_CMSG_CLOEXEC);
+	if (requestLength <= 0) {
+	    return false; // The dealer has gone
+	}
+	struct cmsghdr* pipesMessage = CMSG_FIRSTHDR(&requestMessage);
+	if (!pipesMessage || pipesMessage->cmsg_type != SCM_RIGHTS ||
+		pipesMessage->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+	    continue;
+	}
+	int gamePipes[2];
+	memcpy(gamePipes, CMSG_DATA(pipesMessage), sizeof(gamePipes));
+	request[requestLength] = '\0';
+
+	pid_t processID = fork();
+	if (!processID) {
+	    // Replacing stdin and stdout also closes the control socket
+	    signal(SIGCHLD, SIG_DFL);
+	    dup2(gamePipes[0], STDIN_FILENO);
+	    dup2(gamePipes[1], STDOUT_FILENO);
+	    close(gamePipes[0]);
+	    close(gamePipes[1]);
+
+	    // Arguments are then validated as usual by setup_player()
+	    strcpy(playerCountArg, request);
+	    char* playerIDArg = strchr(playerCountArg, ',');
+	    if (playerIDArg) {
+		*playerIDArg++ = '\0';
+	    }
+	    playerArgs[0] = (*argv)[0];
+	    playerArgs[1] = playerCountArg;
+	    playerArgs[2] = playerIDArg ? playerIDArg : "";
+	    playerArgs[3] = NULL;
+	    *argc = NUM_COMMAND_LINE_ARGS;
+	    *argv = playerArgs;
+	    return true;
+	}
+	close(gamePipes[0]);
+	close(gamePipes[1]);
+	char reply[INITIAL_BUFFER_SIZE];
+	int replyLength = snprintf(reply, INITIAL_BUFFER_SIZE, "%d",
+		(int)processID);
+	if (write(STDOUT_FILENO, reply, replyLength) != replyLength) {
+	    return false;
+	}
+    }
+}
+
+bool stderr_discarded(void) {
+    struct stat stderrDetails, devNullDetails;
+    if (fstat(STDERR_FILENO, &stderrDetails) ||
+	    stat("/dev/null", &devNullDetails)) {
+	return false; // If unsure, keep displaying
+    }
+    // /dev/null is a character device, so compare device numbers
+    return S_ISCHR(stderrDetails.st_mode) &&
+	    stderrDetails.st_rdev == devNullDetails.st_rdev;
+}
+
+bool setup_trusted_mode(Game* game, char* period) {
+    if (!period) {
+	return false;
+    }
+    char* periodErrors = NULL;
+    int checksumPeriod = strtol(period, &periodErrors, 10);
+    if (checksumPeriod < 0 || strtol_invalid(period, periodErrors)) {
+	return false; // Untrusted unless the mode is requested correctly
+    }
+    game->trustedDealer = true;
+    game->checksumPeriod = checksumPeriod;
+    return true;
+}
+
 Game* init_game(char* pathFromFile, int playerCount) {
     Game* game = (Game*)malloc(sizeof(Game));
     game->playerCount = playerCount;
+    game->displayEnabled = true;
+    game->rearmostSite = 0;
+    game->mostCards = 0;
+    game->cardLeader = INVALID_PLAYER_ID;
+    game->numMoves = 0;
+    game->messageSize = HAP_MESSAGE_SIZE;
+    game->message = (char*)malloc(game->messageSize * sizeof(char));
+    game->displayCursors = NULL;
+    // Untrusted until the dealer says otherwise
+    game->trustedDealer = false;
+    game->checksumPeriod = 0;
     init_game_players(game);
     init_game_path(game, pathFromFile);
     init_game_site_players(game);
@@ -86,6 +255,8 @@ void init_game_path(Game* game, char* pathFromFile) {
 		path->sites[site].type[j] = pathSites[pathIndex++];
 	    } else {
 		path->sites[site].type[j] = '\0'; // Site type is string
+		path->sites[site].siteType =
+			get_site_type(path->sites[site].type);
 
 		// Index indicates this char is site limit. Ensure barrier
 		// can hold all players
@@ -98,37 +269,67 @@ void init_game_path(Game* game, char* pathFromFile) {
 	    }
 	}
     }
+    init_site_successors(path);
     game->path = path;
 }
 
-void init_game_site_players(Game* game) {
-    for (int site = 0; site < game->path->numSites; site++) {
-	// Initialise dynamic array to store players at site, used to ensure
-	// correct ordering when displaying players in order of most recent
-	// arrival to a site. Initialise each element to INVALID_PLAYER_ID.
-	game->path->sites[site].playersAtSite =
-		(int*)malloc(game->playerCount * sizeof(int));
-
-	for (int player = 0; player < game->playerCount; player++) {
-	    // At the beginning of the game, all sites but the first should
-	    // have no players
-	    if (site != 0) {
-		game->path->sites[site].playersAtSite[player] =
-			INVALID_PLAYER_ID;
-	    } else {
-		// Ensure descending order of array values but ascending order
-		// of array index
-		game->path->sites[site].playersAtSite[player] =
-			game->playerCount - 1 - player;
+void init_site_successors(Path* path) {
+    // The nearest site of each type in front of the site currently being
+    // examined, found by walking the path backwards. The last site is a
+    // barrier, so nothing lies in front of it.
+    int upcomingSiteOfType[NUM_SITE_TYPES];
+    for (int type = 0; type < NUM_SITE_TYPES; type++) {
+	upcomingSiteOfType[type] = INVALID_SITE;
+    }
+
+    for (int site = path->numSites - 1; site >= 0; site--) {
+	memcpy(path->sites[site].nextSiteOfType, upcomingSiteOfType,
+		sizeof(upcomingSiteOfType));
+
+	// A barrier cannot be skipped, so sites before it may only reach the
+	// barrier itself
+	if (path->sites[site].siteType == SITE_BARRIER) {
+	    for (int type = 0; type < NUM_SITE_TYPES; type++) {
+		upcomingSiteOfType[type] = INVALID_SITE;
 	    }
 	}
+	upcomingSiteOfType[path->sites[site].siteType] = site;
+    }
+}
+
+void init_game_site_players(Game* game) {
+    // All players start at the first site
+    Path* path = game->path;
+    path->occupancyWords = (game->playerCount + OCCUPANCY_WORD_BITS - 1) /
+	    OCCUPANCY_WORD_BITS;
+    path->occupancy = (uint64_t*)calloc(path->numSites *
+	    path->occupancyWords, sizeof(uint64_t));
+    for (int player = 0; player < game->playerCount; player++) {
+	site_occupancy(path, 0)[player / OCCUPANCY_WORD_BITS] |=
+		(uint64_t)1 << (player % OCCUPANCY_WORD_BITS);
+    }
+
+    // At the beginning of the game, all sites but the first have no
+    // players. Players are listed at the first site in descending order of
+    // ID, so that player 0 is at the bottom.
+    for (int site = 0; site < game->path->numSites; site++) {
+	game->path->sites[site].firstArrival = (site) ? INVALID_PLAYER_ID :
+		game->playerCount - 1;
+	game->path->sites[site].lastArrival = (site) ? INVALID_PLAYER_ID : 0;
+    }
+    for (int player = 0; player < game->playerCount; player++) {
+	game->players[player]->prevAtSite = (player == game->playerCount - 1)
+		? INVALID_PLAYER_ID : player + 1;
+	game->players[player]->nextAtSite = (player == 0) ? INVALID_PLAYER_ID
+		: player - 1;
     }
 }
 
 void init_game_players(Game* game) {
     game->players = (Player**)malloc(game->playerCount * sizeof(Player*));
+    game->playerStates = (Player*)malloc(game->playerCount * sizeof(Player));
     for (int player = 0; player < game->playerCount; player++) {
-	game->players[player] = (Player*)malloc(sizeof(Player));
+	game->players[player] = &game->playerStates[player];
 	game->players[player]->playerID = player;
 	game->players[player]->money = 7; // Each player starts with 7 money
 	game->players[player]->numPoints = 0;
@@ -140,6 +341,7 @@ void init_game_players(Game* game) {
 	game->players[player]->numCards[2] = 0;
 	game->players[player]->numCards[3] = 0;
 	game->players[player]->numCards[4] = 0;
+	game->players[player]->totalCards = 0;
     }
 }
 
@@ -229,26 +431,52 @@ bool get_line(char** buffer, size_t* lineLength, FILE* sourceOfLine) {
     return input != EOF;
 }
 
-MessageType get_message_type(Game* game, Player* thisPlayer,
-	char* dealerOrPlayerMessage) {
-    if (!strcmp(dealerOrPlayerMessage, "YT")) {
-	return MESSAGE_YT;
-    } 
-
-    if (do_message_valid(game, thisPlayer, dealerOrPlayerMessage)) {
-	return MESSAGE_DO;
-    }
-
-    if (!strcmp(dealerOrPlayerMessage, "EARLY")) {
-	return MESSAGE_EARLY;
-    }
-
-    if (!strcmp(dealerOrPlayerMessage, "DONE")) {
-	return MESSAGE_DONE;
-    }
-
-    if (hap_message_valid(game, dealerOrPlayerMessage)) {
-	return MESSAGE_HAP;
+MessageType decode_message(Game* game, Player* thisPlayer,
+	char* dealerOrPlayerMessage, HapDetails* details) {
+    // Each message type starts with a different letter (apart from DO and
+    // DONE), so only one message type needs to be checked
+    switch (dealerOrPlayerMessage[0]) {
+	case 'Y':
+	    if (!strcmp(dealerOrPlayerMessage, "YT")) {
+		return MESSAGE_YT;
+	    }
+	    break;
+	case 'D':
+	    if (!strcmp(dealerOrPlayerMessage, "DONE")) {
+		return MESSAGE_DONE;
+	    }
+	    if (decode_do_message(game, thisPlayer, dealerOrPlayerMessage,
+		    details)) {
+		return MESSAGE_DO;
+	    }
+	    break;
+	case 'E':
+	    if (!strcmp(dealerOrPlayerMessage, "EARLY")) {
+		return MESSAGE_EARLY;
+	    }
+	    break;
+	case 'H':
+	    if (game->trustedDealer ? decode_trusted_hap_message(game,
+		    dealerOrPlayerMessage, details) : decode_hap_message(game,
+		    dealerOrPlayerMessage, details)) {
+		return MESSAGE_HAP;
+	    }
+	    break;
+	case 'S':
+	    if (sum_message_valid(game, dealerOrPlayerMessage)) {
+		return MESSAGE_SUM;
+	    }
+	    if (state_message_valid(game, dealerOrPlayerMessage)) {
+		return MESSAGE_STATE;
+	    }
+	    break;
+	case 'T':
+	    if (trust_message_valid(game, dealerOrPlayerMessage)) {
+		return MESSAGE_TRUST;
+	    }
+	    break;
+	default:
+	    break;
     }
     return MESSAGE_ERROR;
 }
@@ -282,22 +510,24 @@ SiteType get_site_type(char* site) {
 
 int get_first_site_of_type(SiteType siteType, Player* thisPlayer,
 	Game* game) {
-    int nextSite = thisPlayer->currentSite + 1;
-    for (int site = nextSite; site < game->path->numSites; site++) {
-	if (!check_site_full(game, site) &&
-		!check_barrier_skipped(game, thisPlayer, site) &&
-		get_site_type(game->path->sites[site].type) == siteType) {
-	    return site;
+    Site* sites = game->path->sites;
+    int site = sites[thisPlayer->currentSite].nextSiteOfType[siteType];
+
+    // Successors never skip a barrier, so only fullness needs checking
+    while (site != INVALID_SITE && check_site_full(game, site)) {
+	// Moving beyond a full barrier would skip it
+	if (siteType == SITE_BARRIER) {
+	    return INVALID_SITE;
 	}
+	site = sites[site].nextSiteOfType[siteType];
     }
-    return INVALID_SITE;
+    return site;
 }
 
-bool do_message_valid(Game* game, Player* thisPlayer,
-	char* dealerOrPlayerMessage) { 
-    // Here, strstr returns pointer to first occurrence of string "DO" in the
-    // dealer/player message. Check if said message begins with "DO"
-    if (strstr(dealerOrPlayerMessage, "DO") - dealerOrPlayerMessage != 0) {
+bool decode_do_message(Game* game, Player* thisPlayer,
+	char* dealerOrPlayerMessage, HapDetails* details) {
+    // Check if said message begins with "DO"
+    if (strncmp(dealerOrPlayerMessage, "DO", 2)) {
 	return false;
     }
 
@@ -323,13 +553,15 @@ bool do_message_valid(Game* game, Player* thisPlayer,
 	    check_barrier_skipped(game, thisPlayer, newSite)) {
 	return false;
     }
+    details->playerID = thisPlayer->playerID;
+    details->newSite = newSite;
     return true;
 }
 
-bool hap_message_valid(Game* game, char* dealerOrPlayerMessage) {
-    // Here, strstr returns pointer to first occurrence of string "HAP" in the
-    // dealer/player message. Check if said message begins with "HAP"
-    if (strstr(dealerOrPlayerMessage, "HAP") - dealerOrPlayerMessage != 0) {
+bool decode_hap_message(Game* game, char* dealerOrPlayerMessage,
+	HapDetails* details) {
+    // Check if said message begins with "HAP"
+    if (strncmp(dealerOrPlayerMessage, "HAP", 3)) {
 	return false;
     }
 
@@ -341,6 +573,13 @@ bool hap_message_valid(Game* game, char* dealerOrPlayerMessage) {
 	    hap_invalid_chars(dealerOrPlayerMessage + 3, errorBuffer)) {
 	return false;
     }
+    // Store each component of the HAP message as it is validated, in HAP
+    // order
+    int* components[NUM_HAP_COMPONENTS] = {&details->playerID,
+	    &details->newSite, &details->additionalPoints,
+	    &details->moneyChange, &details->cardDrawn};
+    *components[MOVE_PLAYER_ID] = playerID;
+
     // Iterate through components of HAP message. First component (i.e. Player
     // ID) validation handled, so start at i = MOVE_NEW_SITE. Iterate until
     // i = MOVE_MONEY_CHANGE. Handle final case (i.e. MOVE_CARD_DRAWN)
@@ -356,6 +595,7 @@ bool hap_message_valid(Game* game, char* dealerOrPlayerMessage) {
 		i)) {
 	    return false;
 	}
+	*components[i] = valueToCheck;
     }
     
     // Ensure card drawn refers to a real card. Also ensure no invalid chars
@@ -367,9 +607,207 @@ bool hap_message_valid(Game* game, char* dealerOrPlayerMessage) {
 	    MOVE_CARD_DRAWN)) {
 	return false;
     }
+    *components[MOVE_CARD_DRAWN] = cardDrawn;
     return true;
 }
 
+bool decode_trusted_hap_message(Game* game, char* dealerMessage,
+	HapDetails* details) {
+    if (strncmp(dealerMessage, "HAP", 3)) {
+	return false;
+    }
+    int* components[NUM_HAP_COMPONENTS] = {&details->playerID,
+	    &details->newSite, &details->additionalPoints,
+	    &details->moneyChange, &details->cardDrawn};
+
+    // Components are separated by commas, and the last ends the message. HAP
+    // is 3 chars, so start after HAP, i.e. at index 3
+    char* component = dealerMessage + 3;
+    for (int i = MOVE_PLAYER_ID; i < NUM_HAP_COMPONENTS; i++) {
+	char* componentEnd = NULL;
+	*components[i] = strtol(component, &componentEnd, 10);
+	char separator = (i == MOVE_CARD_DRAWN) ? '\0' : ',';
+	if (componentEnd == component || *componentEnd != separator) {
+	    return false;
+	}
+	component = componentEnd + 1;
+    }
+    // The dealer is trusted to send legal moves, so only ensure the move
+    // cannot refer outside the game representation
+    return details->playerID >= 0 && details->playerID < game->playerCount &&
+	    details->newSite >= 0 &&
+	    details->newSite < game->path->numSites &&
+	    details->cardDrawn >= 0 && details->cardDrawn <= NUM_CARD_TYPES;
+}
+
+bool sum_message_valid(Game* game, char* dealerMessage) {
+    if (strncmp(dealerMessage, "SUM", 3)) {
+	return false;
+    }
+    // SUM is 3 chars, so start after SUM, i.e. at index 3
+    char* checksumErrors = NULL;
+    unsigned long checksum = strtoul(dealerMessage + 3, &checksumErrors, 10);
+    if (strtol_invalid(dealerMessage + 3, checksumErrors)) {
+	return false;
+    }
+    return checksum == calculate_game_checksum(game);
+}
+
+bool trust_message_valid(Game* game, char* dealerMessage) {
+    if (strncmp(dealerMessage, "TRUST", 5) || game->trustedDealer ||
+	    game->numMoves) {
+	return false;
+    }
+    // TRUST is 5 chars, so start after TRUST, i.e. at index 5
+    char* periodErrors = NULL;
+    long checksumPeriod = strtol(dealerMessage + 5, &periodErrors, 10);
+    return checksumPeriod >= 0 &&
+	    !strtol_invalid(dealerMessage + 5, periodErrors);
+}
+
+unsigned int calculate_game_checksum(Game* game) {
+    unsigned int checksum = CHECKSUM_SEED;
+    for (int player = 0; player < game->playerCount; player++) {
+	Player* thisPlayer = game->players[player];
+	int details[] = {thisPlayer->currentSite, thisPlayer->money,
+		thisPlayer->numPoints, thisPlayer->numV1SitesVisited,
+		thisPlayer->numV2SitesVisited};
+	for (int i = 0; i < sizeof(details) / sizeof(int); i++) {
+	    checksum = (checksum ^ (unsigned int)details[i]) * CHECKSUM_PRIME;
+	}
+	for (int cardType = 0; cardType < NUM_CARD_TYPES; cardType++) {
+	    checksum = (checksum ^ (unsigned int)thisPlayer->numCards[cardType])
+		    * CHECKSUM_PRIME;
+	}
+    }
+    return checksum;
+}
+
+bool checksum_due(Game* game) {
+    return game->checksumPeriod &&
+	    !(game->numMoves % game->checksumPeriod);
+}
+
+size_t state_message_size(Game* game) {
+    return sizeof("STATE") - 1 + MAX_INT_WIDTH + game->playerCount *
+	    NUM_STATE_COMPONENTS * (MAX_INT_WIDTH + 1) + sizeof("\n");
+}
+
+int create_state_message(Game* game, char* message) {
+    int length = sprintf(message, "STATE%d", game->numMoves);
+    for (int site = game->rearmostSite; site < game->path->numSites;
+	    site++) {
+	for (int player = game->path->sites[site].firstArrival;
+		player != INVALID_PLAYER_ID;
+		player = game->players[player]->nextAtSite) {
+	    Player* thisPlayer = game->players[player];
+	    length += sprintf(message + length, ";%d,%d,%d,%d,%d,%d",
+		    player, site, thisPlayer->money, thisPlayer->numPoints,
+		    thisPlayer->numV1SitesVisited,
+		    thisPlayer->numV2SitesVisited);
+	    for (int cardType = 0; cardType < NUM_CARD_TYPES; cardType++) {
+		length += sprintf(message + length, ",%d",
+			thisPlayer->numCards[cardType]);
+	    }
+	}
+    }
+    length += sprintf(message + length, "\n");
+    return length;
+}
+
+bool state_message_valid(Game* game, char* dealerMessage) {
+    // Only a game that has just been given the path can be brought up to
+    // date
+    if (strncmp(dealerMessage, "STATE", 5) || game->numMoves) {
+	return false;
+    }
+    // STATE is 5 chars, so start after STATE, i.e. at index 5
+    char* entry = NULL;
+    long numMoves = strtol(dealerMessage + 5, &entry, 10);
+    if (entry == dealerMessage + 5 || numMoves < 0 || numMoves > INT_MAX) {
+	return false;
+    }
+    bool* listed = (bool*)calloc(game->playerCount, sizeof(bool));
+    int components[NUM_STATE_COMPONENTS];
+    int previousSite = 0;
+    int playersAtSite = 0;
+    bool valid = true;
+    for (int player = 0; valid && player < game->playerCount; player++) {
+	valid = *entry == ';' &&
+		(entry = decode_state_entry(entry + 1, components));
+	for (int i = 0; valid && i < NUM_STATE_COMPONENTS; i++) {
+	    valid = components[i] >= 0;
+	}
+	if (!valid || components[STATE_PLAYER_ID] >= game->playerCount ||
+		listed[components[STATE_PLAYER_ID]] ||
+		components[STATE_SITE] < previousSite ||
+		components[STATE_SITE] >= game->path->numSites) {
+	    valid = false;
+	    break;
+	}
+	listed[components[STATE_PLAYER_ID]] = true;
+	playersAtSite = (components[STATE_SITE] == previousSite) ?
+		playersAtSite + 1 : 1;
+	previousSite = components[STATE_SITE];
+	valid = playersAtSite <= game->path->sites[previousSite].limit;
+    }
+    free(listed);
+    return valid && *entry == '\0';
+}
+
+char* decode_state_entry(char* entry, int* components) {
+    // Components are separated by commas, and the last ends the entry
+    for (int i = 0; i < NUM_STATE_COMPONENTS; i++) {
+	char* componentEnd = NULL;
+	long component = strtol(entry, &componentEnd, 10);
+	if (componentEnd == entry || component > INT_MAX ||
+		(i < NUM_STATE_COMPONENTS - 1 && *componentEnd != ',')) {
+	    return NULL;
+	}
+	components[i] = component;
+	entry = componentEnd + (i < NUM_STATE_COMPONENTS - 1);
+    }
+    return entry;
+}
+
+void apply_state_message(Game* game, char* dealerMessage) {
+    char* entry = NULL;
+    game->numMoves = strtol(dealerMessage + 5, &entry, 10);
+    int components[NUM_STATE_COMPONENTS];
+    for (int player = 0; player < game->playerCount; player++) {
+	entry = decode_state_entry(entry + 1, components);
+	Player* thisPlayer = game->players[components[STATE_PLAYER_ID]];
+
+	// Moving each player in turn (even to the site they are at) leaves
+	// the players at each site in the order they are listed
+	update_player_sites(game, thisPlayer, thisPlayer->currentSite,
+		components[STATE_SITE]);
+	thisPlayer->currentSite = components[STATE_SITE];
+	thisPlayer->money = components[STATE_MONEY];
+	thisPlayer->numPoints = components[STATE_POINTS];
+	thisPlayer->numV1SitesVisited = components[STATE_V1_SITES];
+	thisPlayer->numV2SitesVisited = components[STATE_V2_SITES];
+	thisPlayer->totalCards = 0;
+	for (int cardType = 0; cardType < NUM_CARD_TYPES; cardType++) {
+	    thisPlayer->numCards[cardType] =
+		    components[STATE_CARDS + cardType];
+	    thisPlayer->totalCards += thisPlayer->numCards[cardType];
+	}
+    }
+    // The card leader is found afresh, as cards were not drawn one by one
+    game->mostCards = 0;
+    game->cardLeader = INVALID_PLAYER_ID;
+    for (int player = 0; player < game->playerCount; player++) {
+	int totalCards = game->players[player]->totalCards;
+	if (totalCards > game->mostCards) {
+	    game->mostCards = totalCards;
+	    game->cardLeader = player;
+	} else if (totalCards == game->mostCards) {
+	    game->cardLeader = INVALID_PLAYER_ID;
+	}
+    }
+}
+
 bool hap_message_number_invalid(Game* game, int playerID, int valueToCheck,
 	HapComponent valueType) {
     bool returnValue = true;
@@ -429,71 +867,86 @@ bool hap_invalid_chars(char* remainderOfHap, char* errorBuffer) {
     return false;
 }
 
-void process_hap_details(Game* game, char* hapMessage, bool playerCalled) {
-    char* errorBuffer = NULL;
-    // HAP is 3 chars, so start after HAP, i.e. at index 3
-    int playerID = strtol(hapMessage + 3, &errorBuffer, 10);
+void process_hap_details(Game* game, HapDetails* details,
+	bool playerCalled) {
+    int playerID = details->playerID;
+    (game->numMoves)++;
 
     // Site player is moving from
     int originalSite = game->players[playerID]->currentSite;
-
-    // The first element in the error buffer is a comma, hence to obtain the
-    // next number, call strtol on errorBuffer + 1
-    int newSite = strtol(errorBuffer + 1, &errorBuffer, 10);
+    int newSite = details->newSite;
     game->players[playerID]->currentSite = newSite;
 
     // Update site information regarding players at sites
     update_player_sites(game, game->players[playerID], originalSite, newSite); 
 
     // Update number of V1/V2 sites visted by moving player 
-    if (!strcmp(game->path->sites[newSite].type, "V1")) {
+    if (game->path->sites[newSite].siteType == SITE_V1) {
 	(game->players[playerID]->numV1SitesVisited)++;
     }
-    if (!strcmp(game->path->sites[newSite].type, "V2")) {
+    if (game->path->sites[newSite].siteType == SITE_V2) {
 	(game->players[playerID]->numV2SitesVisited)++;
     }
 
-    game->players[playerID]->numPoints += strtol(errorBuffer + 1,
-	    &errorBuffer, 10);
-
-    game->players[playerID]->money += strtol(errorBuffer + 1,
-	    &errorBuffer, 10);
+    game->players[playerID]->numPoints += details->additionalPoints;
+    game->players[playerID]->money += details->moneyChange;
+    int cardDrawn = details->cardDrawn;
 
-    int cardDrawn = strtol(errorBuffer + 1, NULL, 10);
-    
     // if a card is actually drawn, i.e. cardDrawn != 0, update the number of
     // cards of the given type that the player has
     if (cardDrawn) {
 	// Zero-based indexing means we must subtract 1
 	(game->players[playerID]->numCards[cardDrawn - 1])++;
+	update_card_leader(game, game->players[playerID]);
+    }
+    if (game->displayEnabled) {
+	FILE* output = (playerCalled) ? stderr : stdout;
+	display_player_details(game, game->players[playerID], output);
     }
-    FILE* output = (playerCalled) ? stderr : stdout;
-    display_player_details(game, game->players[playerID], output);
 }
 
 void update_player_sites(Game* game, Player* movingPlayer, int originalSite,
 	int newSite) {
+    int word = movingPlayer->playerID / OCCUPANCY_WORD_BITS;
+    uint64_t bit = (uint64_t)1 << (movingPlayer->playerID %
+	    OCCUPANCY_WORD_BITS);
+    site_occupancy(game->path, originalSite)[word] &= ~bit;
+    site_occupancy(game->path, newSite)[word] |= bit;
+
+    // Players only move forwards, so the rearmost site only moves forwards
+    // once the last player has left it
+    if (newSite < game->rearmostSite) {
+	game->rearmostSite = newSite;
+    }
+    while (!site_occupied(game->path, game->rearmostSite)) {
+	(game->rearmostSite)++;
+    }
+
     // Remove player from original site
-    for (int player = 0; player < game->playerCount; player++) {
-	if (game->path->sites[originalSite].playersAtSite[player] ==
-		movingPlayer->playerID) {
-	    game->path->sites[originalSite].playersAtSite[player] =
-		    INVALID_PLAYER_ID;
-	}
+    Site* sites = game->path->sites;
+    if (movingPlayer->prevAtSite == INVALID_PLAYER_ID) {
+	sites[originalSite].firstArrival = movingPlayer->nextAtSite;
+    } else {
+	game->players[movingPlayer->prevAtSite]->nextAtSite =
+		movingPlayer->nextAtSite;
+    }
+    if (movingPlayer->nextAtSite == INVALID_PLAYER_ID) {
+	sites[originalSite].lastArrival = movingPlayer->prevAtSite;
+    } else {
+	game->players[movingPlayer->nextAtSite]->prevAtSite =
+		movingPlayer->prevAtSite;
     }
 
-    // Update playersAtSite. Add new player to the first available space
-    // (i.e. space not currently occupied by a player), used to maintain
-    // correct order of players in game display, i.e. in order of most recent
-    // arrival to site
-    for (int player = 0; player < game->playerCount; player++) {
-	if (game->path->sites[newSite].playersAtSite[player] ==
-		INVALID_PLAYER_ID) {
-	    game->path->sites[newSite].playersAtSite[player] =
-		    movingPlayer->playerID;
-	    break; // Ensure to only add player to first available site
-	}
+    // Add player to the bottom of the new site, as its most recent arrival
+    movingPlayer->prevAtSite = sites[newSite].lastArrival;
+    movingPlayer->nextAtSite = INVALID_PLAYER_ID;
+    if (sites[newSite].lastArrival == INVALID_PLAYER_ID) {
+	sites[newSite].firstArrival = movingPlayer->playerID;
+    } else {
+	game->players[sites[newSite].lastArrival]->nextAtSite =
+		movingPlayer->playerID;
     }
+    sites[newSite].lastArrival = movingPlayer->playerID;
 }
 
 void display_player_details(Game* game, Player* thisPlayer,
@@ -529,35 +982,70 @@ void display_player_details(Game* game, Player* thisPlayer,
     fflush(displayLocation);
 }
 
-bool check_site_full(Game* game, int move) {
-    int numPlayersAtSite = 0;
+void update_card_leader(Game* game, Player* drawingPlayer) {
+    (drawingPlayer->totalCards)++;
 
-    // Count the number of players at the site this player wants to move to
-    for (int player = 0; player < game->playerCount; player++) {
-	if (game->players[player]->currentSite == move) {
-	    numPlayersAtSite++;
-	}
+    // Card counts only increase, so only the drawing player can become the
+    // strict leader, or tie with the current leader
+    if (drawingPlayer->totalCards > game->mostCards) {
+	game->mostCards = drawingPlayer->totalCards;
+	game->cardLeader = drawingPlayer->playerID;
+    } else if (drawingPlayer->totalCards == game->mostCards) {
+	game->cardLeader = INVALID_PLAYER_ID;
+    }
+}
+
+uint64_t* site_occupancy(Path* path, int site) {
+    return &path->occupancy[site * path->occupancyWords];
+}
+
+int count_players_at_site(Path* path, int site) {
+    uint64_t* occupancy = site_occupancy(path, site);
+    int numPlayers = 0;
+    for (int word = 0; word < path->occupancyWords; word++) {
+	numPlayers += __builtin_popcountll(occupancy[word]);
+    }
+    return numPlayers;
+}
+
+bool site_occupied(Path* path, int site) {
+    // OR the words together rather than stopping at the first occupied one
+    uint64_t* occupancy = site_occupancy(path, site);
+    uint64_t anyPlayers = 0;
+    for (int word = 0; word < path->occupancyWords; word++) {
+	anyPlayers |= occupancy[word];
     }
+    return anyPlayers;
+}
+
+bool is_behind_all_others(Game* game, Player* thisPlayer) {
+    // This player must be the only player at the rearmost site
+    return thisPlayer->currentSite == game->rearmostSite &&
+	    count_players_at_site(game->path, game->rearmostSite) == 1;
+}
 
+int calculate_whose_turn(Game* game) {
+    // Turn belongs to the player at the bottom of the rearmost site, i.e. its
+    // most recent arrival
+    return game->path->sites[game->rearmostSite].lastArrival;
+}
+
+bool check_site_full(Game* game, int move) {
     // Calculate how many players can move to this site. Check if this is a
     // positive value (i.e. site is not full).
-    if (game->path->sites[move].limit - numPlayersAtSite > 0) {
+    if (game->path->sites[move].limit -
+	    count_players_at_site(game->path, move) > 0) {
 	return false;
     }
     return true;
 }
 
 bool check_barrier_skipped(Game* game, Player* movingPlayer, int move) {
-    // Iterate through all sites
-    for (int site = 0; site < game->path->numSites; site++) {
-	// Check if site is barrier and if said barrier is between the player
-	// and the player's move
-	if (!strcmp(game->path->sites[site].type, "::") && site < move &&
-		movingPlayer->currentSite < site) {
-	    return true;
-	}
-    }
-    return false;
+    // Check if the nearest barrier in front of the player is between the
+    // player and the player's move
+    int nextBarrier = game->path->sites[movingPlayer->currentSite]
+	    .nextSiteOfType[SITE_BARRIER];
+    return nextBarrier != INVALID_SITE && nextBarrier < move;
 }
 
 int character_counter(char* stringToSearch, char characterToCount) {
@@ -675,51 +1163,82 @@ PlayerExitCodes play_game(Game* game, Player* thisPlayer,
 
     bool gameOver = false; // Becomes true of DONE message is received
 
+    // The move this player intends to make, calculated as soon as it becomes
+    // this player's turn so that YT can be answered straight away.
+    // INVALID_SITE if no move has been calculated for the current state.
+    int cachedMove = precompute_move(game, thisPlayer, moveStrategy);
+
     display_game(game, playerCalled);
     while(!gameOver) {
-	size_t dealerMessageMax = INITIAL_BUFFER_SIZE;
-	char* dealerMessage = (char*)malloc(dealerMessageMax * sizeof(char));
+	// Every message is read into the game's buffer, so nothing is
+	// allocated per move
+	HapDetails hapDetails;
 
-        // Populate dealerMessage and throw away the result of get_line.
+	// Populate the message buffer and throw away the result of get_line.
 	// Unless nothing was added (i.e. immediate EOF), the contents should
 	// be processed, hence the return value of get_line is irrelevant here
-	if (get_line(&dealerMessage, &dealerMessageMax, stdin),
-		strlen(dealerMessage) != 0) {
-	    switch(get_message_type(game, thisPlayer, dealerMessage)) {
+	if (get_line(&game->message, &game->messageSize, stdin),
+		strlen(game->message) != 0) {
+	    switch(decode_message(game, thisPlayer, game->message,
+		    &hapDetails)) {
 		case MESSAGE_YT:
-		    printf("DO%d\n", moveStrategy(game, thisPlayer));
+		    printf("DO%d\n", (cachedMove != INVALID_SITE) ?
+			    cachedMove : moveStrategy(game, thisPlayer));
 		    fflush(stdout);
-		    free(dealerMessage);
+		    cachedMove = INVALID_SITE;
 		    break;
 		case MESSAGE_DO:
 		    // Players should not receive DO messages
-		    free(dealerMessage);
 		    return PLAYER_COMMUNICATION;
 		case MESSAGE_EARLY:
-		    free(dealerMessage);
 		    return PLAYER_EARLY;
 		case MESSAGE_DONE:
 		    gameOver = true;
-		    free(dealerMessage);
 		    calculate_final_scores(game, playerCalled);
 		    break;
 		case MESSAGE_HAP:
-		    process_hap_details(game, dealerMessage, playerCalled);
-		    free(dealerMessage);
+		    process_hap_details(game, &hapDetails, playerCalled);
 		    display_game(game, playerCalled);
+
+		    // The game state has changed, so any cached move is stale
+		    cachedMove = precompute_move(game, thisPlayer,
+			    moveStrategy);
+		    break;
+		case MESSAGE_SUM:
+		    // Game state matches the dealer's
+		    break;
+		case MESSAGE_TRUST:
+		    // TRUST is 5 chars, so the period starts at index 5
+		    setup_trusted_mode(game, game->message + 5);
+		    break;
+		case MESSAGE_STATE:
+		    // The game is being resumed, so catch up all at once
+		    apply_state_message(game, game->message);
+		    display_game(game, playerCalled);
+		    cachedMove = precompute_move(game, thisPlayer,
+			    moveStrategy);
 		    break;
 		case MESSAGE_ERROR:
-		    free(dealerMessage);
 		    return PLAYER_COMMUNICATION;
 	    }
 	} else {
-	    free(dealerMessage);
 	    return PLAYER_COMMUNICATION;
 	}
     }
     return PLAYER_NORMAL;
 }
 
+int precompute_move(Game* game, Player* thisPlayer,
+	int (*moveStrategy)(Game* game, Player* thisPlayer)) {
+    // Once every player is on the last site the game is over, and there are
+    // no moves left to make
+    if (game->rearmostSite == game->path->numSites - 1 ||
+	    calculate_whose_turn(game) != thisPlayer->playerID) {
+	return INVALID_SITE;
+    }
+    return moveStrategy(game, thisPlayer);
+}
+
 void calculate_final_scores(Game* game, bool playerCalled) {
     FILE* output = (playerCalled) ? stderr : stdout;
 
@@ -785,6 +1304,10 @@ void calculate_score_from_cards(Player* player) {
 }
 
 void display_game(Game* game, bool playerCalled) {
+    // Nobody is watching, hence skip building and printing the display
+    if (!game->displayEnabled) {
+	return;
+    }
     FILE* output = (playerCalled) ? stderr : stdout;
 
     // display path
@@ -795,125 +1318,72 @@ void display_game(Game* game, bool playerCalled) {
     fprintf(output, "\n");
     fflush(output);
 
-    // Store player positions into 2D array
-    int** playerDisplay = init_player_positions(game); 
-
-    // Sort 2D array to fit required game display formatting (i.e. no blank
-    // spaces above/below)
-    sort_player_positions(game, &playerDisplay);
-    
-    // With this array construction, game->playerCount rows will be displayed
-    // after every move. In the cases where this is unwanted (e.g. all players
-    // are on different sites and hence only one row should be displayed), a
-    // series of blank rows (i.e. rows with all spaces) will be printed.
-    // Ensure this doesn't occur.
-    clean_player_display(game, &playerDisplay); 
-
-    // display player positions
-    for (int row = 0; row < game->playerCount; row++) {
-	// Ensure not to print blank lines full of spaces
-	if (playerDisplay[row][0] == EMPTY_LINE) {
-	    continue;
-	}
-	for (int col = 0; col < SITE_LENGTH * game->path->numSites; col++) {
-	    if (playerDisplay[row][col] == INVALID_PLAYER_ID) {
-		// Ensure correct spacing of players
-		fprintf(output, " ");
-		fflush(output);
-	    } else {
-		// Display player
-		fprintf(output, "%d", playerDisplay[row][col]);
-		fflush(output);
-	    }
-	}
-	fprintf(output, "\n");
-	fflush(output);
-    }
-    // Free playerDisplay
-    for (int row = 0; row < game->playerCount; row++) {
-	free(playerDisplay[row]);
+    // display player positions, one row at a time until every player at
+    // the most crowded site has been displayed (i.e. no blank rows)
+    int* displayCursors = init_display_cursors(game);
+    while (display_player_row(game, displayCursors, output)) {
+	// Each call displays one row
     }
-    free(playerDisplay);
 }
 
-int** init_player_positions(Game* game) {
-    // Create 2D array to store player positions on game display
-    int** playerDisplay = (int**)malloc(game->playerCount * sizeof(int*));
-    for (int row = 0; row < game->playerCount; row++) {
-	// Allocate enough size to store the path length
-	playerDisplay[row] = (int*)malloc(
-		(SITE_LENGTH * game->path->numSites) * sizeof(int));
+int* init_display_cursors(Game* game) {
+    if (!game->displayCursors) {
+	game->displayCursors = (int*)malloc(game->path->numSites *
+		sizeof(int));
     }
-
-    for (int col = 0; col < SITE_LENGTH * game->path->numSites; col++) {
-	for (int player = 0; player < game->playerCount; player++) {
-	    if (!(col % SITE_LENGTH)) {
-		int currentSite = col / SITE_LENGTH;
-		playerDisplay[player][col] =
-			game->path->sites[currentSite].playersAtSite[player];
-	    } else {
-		playerDisplay[player][col] = INVALID_PLAYER_ID;
-	    }
-	}
+    for (int site = 0; site < game->path->numSites; site++) {
+	game->displayCursors[site] = game->path->sites[site].firstArrival;
     }
-    return playerDisplay;
+    return game->displayCursors;
 }
 
-void sort_player_positions(Game* game, int*** playerDisplay) {
-    for (int col = 0; col < SITE_LENGTH * game->path->numSites; col++) {
-	for (int row = 0; row < game->playerCount; row++) {
-	    // Compare each element in column with top row and work downwards
-	    for (int rowNext = row + 1; rowNext < game->playerCount;
-		    rowNext++) {
-		
-		// Standard swap with temporary variable
-		if ((*playerDisplay)[row][col] == INVALID_PLAYER_ID) {
-		    int tmp = (*playerDisplay)[row][col];
-		    (*playerDisplay)[row][col] =
-			    (*playerDisplay)[rowNext][col];
-		    (*playerDisplay)[rowNext][col] = tmp;
-		}
-	    }
+bool display_player_row(Game* game, int* displayCursors, FILE* output) {
+    // Ensure not to print blank lines full of spaces
+    bool playersLeft = false;
+    for (int site = 0; site < game->path->numSites; site++) {
+	if (displayCursors[site] != INVALID_PLAYER_ID) {
+	    playersLeft = true;
+	    break;
 	}
     }
-}
-
-void clean_player_display(Game* game, int*** playerDisplay) {
-    for (int row = 0; row < game->playerCount; row++) {
-	int spaceCounter = 0;
-	for (int col = 0; col < SITE_LENGTH * game->path->numSites; col++) {
-	    if ((*playerDisplay)[row][col] == INVALID_PLAYER_ID) {
-		spaceCounter++;
-	    }
-	}
-	// Check if entire row in player display is nothing but spaces (i.e.
-	// no players exist on this row). If so, mark the beginning of the row
-	// with a sentinel to ensure random extra vertical whitespace is not
-	// displayed to user
-	if (spaceCounter == SITE_LENGTH * game->path->numSites) {
-	    (*playerDisplay)[row][0] = EMPTY_LINE;
+    if (!playersLeft) {
+	return false;
+    }
+    for (int col = 0; col < SITE_LENGTH * game->path->numSites; col++) {
+	int site = col / SITE_LENGTH;
+	if (col % SITE_LENGTH || displayCursors[site] == INVALID_PLAYER_ID) {
+	    // Ensure correct spacing of players
+	    fprintf(output, " ");
+	    fflush(output);
+	} else {
+	    // Display player, then move down the site
+	    fprintf(output, "%d", displayCursors[site]);
+	    fflush(output);
+	    displayCursors[site] =
+		    game->players[displayCursors[site]]->nextAtSite;
 	}
     }
+    fprintf(output, "\n");
+    fflush(output);
+    return true;
 }
 
 void free_game(Game* game, char* pathFromFile) {
-    // Free the players at the path sites
-    for (int site = 0; site < game->path->numSites; site++) {
-	free(game->path->sites[site].playersAtSite);
-    } 
-
     // Free the path sites and the path
     free(game->path->sites);
+    free(game->path->occupancy);
     free(game->path);
 
     // Free the (validated) path from the given path file
     free(pathFromFile);
 
     // Free the player representations
-    for (int player = 0; player < game->playerCount; player++) {
-	free(game->players[player]);
-    }
+    free(game->playerStates);
     free(game->players);
+
+    // Free the buffers reused for every move
+    free(game->message);
+    free(game->displayCursors);
     
     // Free the game
     free(game);
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <ctype.h>
 #include "playerErrors.h"
 #include "dealerErrors.h"
@@ -15,6 +16,10 @@
 /* The number of card types */
 #define NUM_CARD_TYPES 5
 
+/* Number of players whose occupancy fits in one word of a site's occupancy
+ * bitset */
+#define OCCUPANCY_WORD_BITS 64
+
 /* The get_line() function re-allocates memory if necessary. Hence, whenever
  * using get_line, let us begin with an initial buffer size of 30 bytes. */
 #define INITIAL_BUFFER_SIZE 30
@@ -37,29 +42,81 @@
  * of the path that players are not currently at. */
 #define INVALID_PLAYER_ID (-1)
 
-/* The player ID must be non-negative. Hence, for error-checking, we may use
- * the value -2 as a sentinel. The game display is presented in a grid-form,
- * where the rows represent each player, and the columns represent each char
- * in a site representation (i.e. including spaces). An empty row shall begin
- * with a sentinel value of -2. */
-#define EMPTY_LINE (-2)
-
 /* Site number must be non-negative. For error-checking, we may use the value
  * -3 as a sentinel. For example, when calculating the next site a player
  * should move to, this value may be used if no site is found. */
 #define INVALID_SITE (-3)
 
+/* Environment variable that puts the dealer in trusted mode. Its value is the
+ * number of moves between SUM (game state checksum) messages sent by the
+ * dealer, or 0 for none. The dealer announces the mode by sending TRUSTn
+ * (where n is said number) straight after the path, and players only enable
+ * trusted mode on receiving it. In trusted mode, players only check that HAP
+ * messages are well-formed, not that the moves are legal. */
+#define TRUSTED_DEALER_ENV "TRUSTED_DEALER"
+
+/* Environment variable that makes players pooled, i.e. reused by the dealer
+ * across games. Players inherit it from the dealer. Once a game is over, a
+ * pooled player waits for NEWGAMEc,i (c being the player count and i its ID)
+ * and then plays a new game as if it had just been started (sending ^ and
+ * receiving the path), until the dealer closes its stdin. */
+#define PERSISTENT_PLAYER_ENV "PERSISTENT_PLAYER"
+
+/* Environment variable that makes the dealer fork players from zygotes
+ * instead of starting each one afresh. A zygote is a player program started
+ * once, as "player --zygote", with a control socket as its stdin and stdout.
+ * For each game, the dealer sends it "c,i" (the player count and ID) along
+ * with the ends of the game pipes, and the zygote forks a player already
+ * wired to them, replying with the player's PID. */
+#define ZYGOTE_PLAYER_ENV "ZYGOTE_PLAYER"
+#define ZYGOTE_MODE_ARG "--zygote"
+
+/* Initial value and multiplier of the game state checksum (32-bit FNV-1a) */
+#define CHECKSUM_SEED 2166136261u
+#define CHECKSUM_PRIME 16777619u
+
+/* Site Types */
+typedef enum {
+    SITE_MO = 0,
+    SITE_V1 = 1,
+    SITE_V2 = 2,
+    SITE_DO = 3,
+    SITE_RI = 4,
+    SITE_BARRIER = 5,
+    SITE_ERROR = 6
+} SiteType;
+
 /* Site representation */
 typedef struct {
     char type[SITE_LENGTH];
+    SiteType siteType;
     int limit;
-    int* playersAtSite;
+
+    // Players at this site in order of arrival, as a list linked through
+    // each Player's prevAtSite and nextAtSite (INVALID_PLAYER_ID if the site
+    // is empty). The first arrival is displayed at the top of the site, and
+    // the last arrival at the bottom.
+    int firstArrival;
+    int lastArrival;
+
+    // Successor tables. For each site type, stores the first site of that
+    // type after this site that can be reached without skipping a barrier
+    // (the next barrier itself is reachable), or INVALID_SITE if there is no
+    // such site. e.g. nextSiteOfType[SITE_DO] == the nearest Do site in front
+    // of this site and before the next barrier.
+    int nextSiteOfType[NUM_SITE_TYPES];
 } Site;
 
 /* Path representation */
 typedef struct {
     int numSites;
     Site* sites;
+
+    // Occupancy bitsets of every site, stored contiguously. Each site has
+    // occupancyWords words, and bit p (of word p / OCCUPANCY_WORD_BITS) is
+    // set if player p is at the site. Counting players is then a popcount.
+    int occupancyWords;
+    uint64_t* occupancy;
 } Path;
 
 /* Player representation */
@@ -75,6 +132,14 @@ typedef struct {
     // e.g. numCards[0] == number of A cards drawn, numCards[1] == number of B
     // cards drawn, etc.
     int numCards[NUM_CARD_TYPES];
+
+    // Total number of cards drawn by this player (of any type)
+    int totalCards;
+
+    // Players that arrived at this player's current site just before and
+    // just after this player (see Site), or INVALID_PLAYER_ID if none
+    int prevAtSite;
+    int nextAtSite;
 } Player;
 
 /* Game representation */
@@ -82,6 +147,40 @@ typedef struct {
     Path* path;
     Player** players;
     int playerCount;
+
+    // The player representations themselves, stored contiguously (players
+    // points into this)
+    Player* playerStates;
+
+    // Whether game and player details should be displayed. Players whose
+    // stderr is discarded (e.g. re-directed to /dev/null by the dealer) skip
+    // all rendering.
+    bool displayEnabled;
+
+    // Opponent trackers, updated as HAP messages are processed. The rearmost
+    // site is the lowest site any player is currently at.
+    int rearmostSite;
+
+    // The most cards held by any one player, and the player holding them.
+    // cardLeader is INVALID_PLAYER_ID if several players share this amount.
+    int mostCards;
+    int cardLeader;
+
+    // Whether the dealer is trusted to only send legal moves (see
+    // TRUSTED_DEALER_ENV), and the number of moves between checksums (0 if
+    // none are sent)
+    bool trustedDealer;
+    int checksumPeriod;
+
+    // Number of moves made so far
+    int numMoves;
+
+    // Buffers reused for every move of the game: the line most recently
+    // received from the dealer (grown as needed), and the display cursors
+    // (see init_display_cursors(), NULL until first displayed)
+    char* message;
+    size_t messageSize;
+    int* displayCursors;
 } Game;
 
 /* Message Types */
@@ -91,20 +190,12 @@ typedef enum {
     MESSAGE_EARLY = 2,
     MESSAGE_DONE = 3,
     MESSAGE_HAP = 4,
-    MESSAGE_ERROR = 5
+    MESSAGE_SUM = 5,
+    MESSAGE_TRUST = 6,
+    MESSAGE_STATE = 7,
+    MESSAGE_ERROR = 8
 } MessageType;
 
-/* Site Types */
-typedef enum {
-    SITE_MO = 0,
-    SITE_V1 = 1,
-    SITE_V2 = 2,
-    SITE_DO = 3,
-    SITE_RI = 4,
-    SITE_BARRIER = 5,
-    SITE_ERROR = 6
-} SiteType;
-
 /* Components of HAP message. */
 typedef enum {
     MOVE_PLAYER_ID = 0,
@@ -114,6 +205,48 @@ typedef enum {
     MOVE_CARD_DRAWN = 4
 } HapComponent;
 
+/* Number of components in a HAP message */
+#define NUM_HAP_COMPONENTS 5
+
+/* Components of each player's entry in a STATE message, the last being the
+ * number of A cards held (followed by the other card types, in order). */
+typedef enum {
+    STATE_PLAYER_ID = 0,
+    STATE_SITE = 1,
+    STATE_MONEY = 2,
+    STATE_POINTS = 3,
+    STATE_V1_SITES = 4,
+    STATE_V2_SITES = 5,
+    STATE_CARDS = 6
+} StateComponent;
+
+/* Number of components in each player's entry in a STATE message */
+#define NUM_STATE_COMPONENTS (STATE_CARDS + NUM_CARD_TYPES)
+
+/* Most chars an int takes to print (e.g. -2147483648) */
+#define MAX_INT_WIDTH 11
+
+/* Size of a buffer that holds any HAP message, i.e. HAP followed by each
+ * component and its separator (a comma, or the final newline), and the null
+ * terminator. Received messages longer than this are invalid anyway. */
+#define HAP_MESSAGE_SIZE (sizeof("HAP") - 1 + \
+	NUM_HAP_COMPONENTS * (MAX_INT_WIDTH + 1) + 1)
+
+/* Size of a buffer that holds everything the dealer sends after a move: the
+ * HAP message, a SUM message and a YT message. */
+#define TURN_MESSAGES_SIZE (HAP_MESSAGE_SIZE + sizeof("SUM") - 1 + \
+	MAX_INT_WIDTH + 1 + sizeof("YT\n") - 1)
+
+/* Decoded (and validated) DO or HAP message, i.e. the details of one move. A
+ * DO message only provides the moving player and their new site. */
+typedef struct {
+    int playerID;
+    int newSite;
+    int additionalPoints;
+    int moneyChange;
+    int cardDrawn;
+} HapDetails;
+
 /* Entry point for Player A and Player B programs. Essentially acts as main.
  * Takes in the same parameters as main, as well as unitialised game and
  * player representations, along with an empty buffer to store the path.
@@ -122,6 +255,39 @@ typedef enum {
 PlayerExitCodes setup_player(int argc, char** argv, Game** game,
 	Player** thisPlayer, char** path);
 
+/* Takes in the player count, this player's ID, and uninitialised game and
+ * player representations, along with an empty buffer to store the path.
+ * Sends the ^ handshake, reads and validates the path from the dealer and
+ * sets up the game. Returns the appropriate player exit code (without
+ * displaying its error message). */
+PlayerExitCodes start_player_game(int playerCount, int thisPlayerID,
+	Game** game, Player** thisPlayer, char** path);
+
+/* Takes in the game and player representations and the path of the game
+ * just finished, and a pointer to store any player exit code in. If this
+ * player is pooled (see PERSISTENT_PLAYER_ENV), waits for the dealer to
+ * start another game, and replaces the finished game with it. Returns if
+ * there is another game to play. Otherwise, the finished game is left to be
+ * freed, and *playerError is set if the dealer sent anything invalid. */
+bool next_game(Game** game, Player** thisPlayer, char** path,
+	PlayerExitCodes* playerError);
+
+/* Takes in pointers to the player's command-line arguments. Serves fork
+ * requests from the dealer as a zygote (see ZYGOTE_PLAYER_ENV). Returns true
+ * in each forked player, with the arguments replaced by those of its game,
+ * or false in the zygote once the dealer closes the control socket. */
+bool serve_fork_requests(int* argc, char*** argv);
+
+/* Checks (and returns) if stderr is re-directed to /dev/null, i.e. if any
+ * output displayed to stderr would be discarded. */
+bool stderr_discarded(void);
+
+/* Takes in the game representation and the number of moves between
+ * checksums, as text (e.g. the value of TRUSTED_DEALER_ENV), or NULL. Enables
+ * trusted mode if said number is valid. Returns if trusted mode was enabled.
+ * */
+bool setup_trusted_mode(Game* game, char* period);
+
 /* Takes in the (validated) path from the given path file, as well as the
  * player count. Initialises and returns the game representation. Entry
  * point/wrapper function for initialisation of game representation members.
@@ -132,13 +298,19 @@ Game* init_game(char* pathFromFile, int playerCount);
  * path file. Initialises the game path representation. */
 void init_game_path(Game* game, char* pathFromFile);
 
+/* Takes in the path representation (with site types populated). Initialises
+ * the successor tables of each site, i.e. the next site of each type that can
+ * be reached from said site without skipping a barrier. */
+void init_site_successors(Path* path);
+
 /* Takes in the game representation. Initialises the component of the site
  * representation that tracks which players are on the site. */
 void init_game_site_players(Game* game);
 
-/* Takes in the game representation. Malloc's memory for each player and
- * initialises the player representation information (e.g. initial amount of
- * money, initial position on path, etc.). Does not specify player type. */
+/* Takes in the game representation. Malloc's memory for the players (in one
+ * block) and initialises the player representation information (e.g.
+ * initial amount of money, initial position on path, etc.). Does not specify
+ * player type. */
 void init_game_players(Game* game);
 
 /* Takes in the input converted via strtol call, as well as the error
@@ -162,11 +334,12 @@ int validate_path(char** pathFromFile, size_t* pathLength, FILE* pathSource,
  * */
 bool get_line(char** buffer, size_t* minBufferSize, FILE* sourceOfLine);
 
-/* Takes in the game representation, this player's representation, and a
- * message from either the dealer or the player. Returns the appropriate
- * message type. */
-MessageType get_message_type(Game* game, Player* thisPlayer,
-	char* dealerOrPlayerMessage);
+/* Takes in the game representation, this player's representation, a
+ * message from either the dealer or the player, and an empty HapDetails to
+ * store the contents of DO and HAP messages in. Decodes and validates the
+ * message in a single pass, and returns the appropriate message type. */
+MessageType decode_message(Game* game, Player* thisPlayer,
+	char* dealerOrPlayerMessage, HapDetails* details);
 
 /* Takes in the path representation of a site and returns the appropriate site
  * type. */
@@ -176,22 +349,26 @@ SiteType get_site_type(char* site);
  * and the game representation. Finds the first occurrence of the given site
  * type (in front of the player) on the path, ensuring that no barriers are
  * skipped and that the site is not full, and returns the site number. If no
- * such occurrence is found, INVALID_SITE is returned. */
+ * such occurrence is found, INVALID_SITE is returned. Follows the site
+ * successor tables, so only sites of the given type are visited. */
 int get_first_site_of_type(SiteType siteType, Player* thisPlayer, Game* game);
 
-/* Takes in the game representation, this player's representation, and the
- * dealer/player message. Checks if message is a DO message, and returns if it
- * is a valid DO move. Does not check player strategies. */
-bool do_message_valid(Game* game, Player* thisPlayer,
-	char* dealerOrPlayerMessage);
+/* Takes in the game representation, this player's representation, the
+ * dealer/player message, and an empty HapDetails. Checks if message is a DO
+ * message, and returns if it is a valid DO move, in which case the move is
+ * stored in the HapDetails. Does not check player strategies. */
+bool decode_do_message(Game* game, Player* thisPlayer,
+	char* dealerOrPlayerMessage, HapDetails* details);
 
 /* Takes in the game representation, and the dealer/player message. Checks if
  * message is a HAP message and checks (and returns) if said message is valid.
  * Does not check if said message is the correct action to be taken, only
  * checks if message contents are possible at *some* point in the game (e.g.
  * ensures message refers to a player that exists in the game, does not check
- * if said player should have moved at that point in time). */
-bool hap_message_valid(Game* game, char* dealerOrPlayerMessage);
+ * if said player should have moved at that point in time). Each component
+ * is stored in the given HapDetails as it is validated. */
+bool decode_hap_message(Game* game, char* dealerOrPlayerMessage,
+	HapDetails* details);
 
 /* Takes in the game representation, the player ID in the HAP message, and a
  * value from the HAP message to validate, as well as the type of value (i.e.
@@ -210,17 +387,77 @@ bool hap_message_number_invalid(Game* game, int playerID, int valueToCheck,
  * invalid chars in s, we would pass 's,m,c' into this function. */
 bool hap_invalid_chars(char* remainderOfHap, char* errorBuffer);
 
-/* Takes in the game representation, a (validated) HAP message, and a flag to
- * check if a player or the dealer called this function. This function
+/* Takes in the game representation, the dealer message, and an empty
+ * HapDetails. Used in trusted mode in place of decode_hap_message(). Only
+ * checks that the message is a well-formed HAP message that refers to a real
+ * player, site and card, storing each component in the HapDetails. Returns
+ * if the message is well-formed. */
+bool decode_trusted_hap_message(Game* game, char* dealerMessage,
+	HapDetails* details);
+
+/* Takes in the game representation and the dealer message. Checks if message
+ * is a SUM message, and returns if its checksum matches the checksum of the
+ * game state. */
+bool sum_message_valid(Game* game, char* dealerMessage);
+
+/* Takes in the game representation and the dealer message. Returns if said
+ * message is a valid TRUST message, i.e. TRUSTn where n is a valid number of
+ * moves between checksums, received before any move has been made. */
+bool trust_message_valid(Game* game, char* dealerMessage);
+
+/* Takes in the game representation. Returns a checksum of the state of each
+ * player (position, money, points, and sites and cards collected). */
+unsigned int calculate_game_checksum(Game* game);
+
+/* Takes in the game representation. Returns if a SUM message is due, i.e.
+ * checksums are enabled and the number of moves made is a multiple of the
+ * checksum period. */
+bool checksum_due(Game* game);
+
+/* Takes in the game representation. Returns the size of a buffer that holds
+ * any STATE message of the game (including the newline and null
+ * terminator). */
+size_t state_message_size(Game* game);
+
+/* Takes in the game representation, and a buffer of state_message_size()
+ * chars. Writes a STATE message (with the newline) to said buffer, which
+ * brings a game that has just been given the path up to date in one go.
+ * Returns the length of the message. The message is STATEn (n being the
+ * number of moves made), followed by an entry for each player, in order of
+ * site and then of arrival at the site: ;p,s,m,v,1,2,a,b,c,d,e (player ID,
+ * site, money, points, V1 and V2 sites visited, and cards of each type). */
+int create_state_message(Game* game, char* message);
+
+/* Takes in the game representation, and a message received from the dealer
+ * (without the newline). Returns if it is a STATE message that can be
+ * applied to the game, i.e. no move has been made yet, every player has one
+ * entry, and entries are in order of site without overfilling any site. */
+bool state_message_valid(Game* game, char* dealerMessage);
+
+/* Takes in a position in a STATE message just after a player's entry begins
+ * (i.e. after the ;), along with a buffer of NUM_STATE_COMPONENTS ints.
+ * Stores the entry's components in said buffer. Returns the position after
+ * the entry, or NULL if it is malformed. */
+char* decode_state_entry(char* entry, int* components);
+
+/* Takes in the game representation, and a (validated) STATE message. Sets
+ * the state of each player (and the number of moves made) to that given,
+ * with the players at each site in the given order of arrival. */
+void apply_state_message(Game* game, char* dealerMessage);
+
+/* Takes in the game representation, the details of a (validated) HAP
+ * message, and a flag to check if a player or the dealer called this
+ * function. This function
  * processes the given updates to the game state (i.e. the player ID, the new
  * site, the change in points (if any), the change in money (if any), and the
  * card drawn (if any), of the player who has just moved). */
-void process_hap_details(Game* game, char* hapMessage, bool playerCalled);
+void process_hap_details(Game* game, HapDetails* details,
+	bool playerCalled);
 
 /* Takes in the game representation, the player representation of the moving
  * player, the site that the player is moving from, and the site that the
  * player is moving to. Updates both sites regarding which players are at said
- * sites. */
+ * sites, as well as the rearmost site of the game. */
 void update_player_sites(Game* game, Player* movingPlayer, int originalSite,
 	int newSite);
 
@@ -230,6 +467,30 @@ void update_player_sites(Game* game, Player* movingPlayer, int originalSite,
 void display_player_details(Game* game, Player* thisPlayer,
 	FILE* displayLocation);
 
+/* Takes in the game representation and the representation of the player who
+ * has just drawn a card. Updates the card count trackers accordingly. */
+void update_card_leader(Game* game, Player* drawingPlayer);
+
+/* Takes in the path representation and a site. Returns the occupancy bitset
+ * of said site (see Path). */
+uint64_t* site_occupancy(Path* path, int site);
+
+/* Takes in the path representation and a site. Returns the number of players
+ * at said site. */
+int count_players_at_site(Path* path, int site);
+
+/* Takes in the path representation and a site. Returns if any player is at
+ * said site. */
+bool site_occupied(Path* path, int site);
+
+/* Takes in the game representation and this player's representation. Checks
+ * (and returns) if every other player is strictly in front of this player. */
+bool is_behind_all_others(Game* game, Player* thisPlayer);
+
+/* Takes in the game representation and returns the player ID of the player
+ * who should move next. */
+int calculate_whose_turn(Game* game);
+
 /* Takes in the game representation, and the move that the player would like
  * to make. Checks (and returns) if the site the player would like to move to
  * has room. */
@@ -276,6 +537,13 @@ int validate_site_player_limits(char* pathSitesFromFile, bool playerCalled);
 PlayerExitCodes play_game(Game* game, Player* thisPlayer,
 	int (*moveStrategy)(Game* game, Player* thisPlayer));
 
+/* Takes in the game representation, the player representation of this player,
+ * and their move strategy. If it is this player's turn, calculates (and
+ * returns) the move they will make when asked. Otherwise, returns
+ * INVALID_SITE. */
+int precompute_move(Game* game, Player* thisPlayer,
+	int (*moveStrategy)(Game* game, Player* thisPlayer));
+
 /* Takes in the game representation, and a flag to check if a player or the
  * dealer called this function. Calculates and displays the final scores
  * for each player in the required format (i.e. in player order,
@@ -291,25 +559,16 @@ void calculate_score_from_cards(Player* player);
  * required game format. */
 void display_game(Game* game, bool playerCalled);
 
-/* Takes in the game representation. Creates (and returns) a matrix
- * representation of the player positions. The matrix takes dimensions
- * (number of players) x (number of chars in path). Each element is the player
- * ID, if that player is at that particular position of the path. If no player
- * exists at a particular part of the display, the element is of value
- * INVALID_PLAYER_ID. */
-int** init_player_positions(Game* game);
-
-/* Takes in the game representation and the matrix representation of the
- * player positions. Sorts the matrix to ensure the players at each site are
- * displayed as close to the game path as possible (i.e. no blank spaces
- * above/below). */
-void sort_player_positions(Game* game, int*** playerDisplay);
-
-/* Takes in the game representation and the matrix representation of the
- * player positions. Modifies the matrix to ensure that unnecessary spacing
- * is not present in the final display. This should be called after
- * sort_player_positions. */
-void clean_player_display(Game* game, int*** playerDisplay);
+/* Takes in the game representation. Returns the display cursors (allocated
+ * on the first call and reused for the rest of the game), each set to the
+ * first player to display at its site, i.e. the top of the site. */
+int* init_display_cursors(Game* game);
+
+/* Takes in the game representation, the display cursors and where to display
+ * to. Displays the next row of players, i.e. the player at each cursor, and
+ * moves each cursor down its site. Returns false (displaying nothing) if
+ * every player has already been displayed. */
+bool display_player_row(Game* game, int* displayCursors, FILE* output);
 
 /* Takes in the game representation and the (validated) path from the given
  * path file. Frees the player representations, the game path site
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include "2310alloc.h"
+
+/* Global variable - the phase allocations are currently counted against. */
+AllocPhase allocPhase = ALLOC_LOAD;
+
+#ifdef ALLOC_PROFILE
+/* Allocation counts of each phase, and the bytes currently and at most
+ * allocated at once. Sizes are the usable sizes of the blocks, so that the
+ * bytes freed match the bytes allocated. */
+static AllocCounts allocCounts[NUM_ALLOC_PHASES];
+static long long heapBytes = 0;
+static long long peakHeapBytes = 0;
+
+/* The C library's own allocator, which the replacements below call */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t numMembers, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+extern void __libc_free(void* pointer);
+
+/* Takes in the change in the number of bytes allocated. Updates the current
+ * and peak heap size. */
+static void count_heap_bytes(long long change) {
+    heapBytes += change;
+    if (heapBytes > peakHeapBytes) {
+	peakHeapBytes = heapBytes;
+    }
+}
+
+void* malloc(size_t size) {
+    void* pointer = __libc_malloc(size);
+    if (pointer) {
+	long long blockSize = malloc_usable_size(pointer);
+	allocCounts[allocPhase].numAllocs++;
+	allocCounts[allocPhase].bytesAllocated += blockSize;
+	count_heap_bytes(blockSize);
+    }
+    return pointer;
+}
+
+void* calloc(size_t numMembers, size_t size) {
+    void* pointer = __libc_calloc(numMembers, size);
+    if (pointer) {
+	long long blockSize = malloc_usable_size(pointer);
+	allocCounts[allocPhase].numAllocs++;
+	allocCounts[allocPhase].bytesAllocated += blockSize;
+	count_heap_bytes(blockSize);
+    }
+    return pointer;
+}
+
+void* realloc(void* pointer, size_t size) {
+    if (!pointer) {
+	return malloc(size);
+    }
+    long long oldSize = malloc_usable_size(pointer);
+    void* newPointer = __libc_realloc(pointer, size);
+    // realloc(pointer, 0) may free the block and return NULL
+    if (newPointer || !size) {
+	long long newSize = newPointer ? malloc_usable_size(newPointer) : 0;
+	allocCounts[allocPhase].numReallocs++;
+	if (newSize > oldSize) {
+	    allocCounts[allocPhase].bytesAllocated += newSize - oldSize;
+	}
+	count_heap_bytes(newSize - oldSize);
+    }
+    return newPointer;
+}
+
+void free(void* pointer) {
+    if (pointer) {
+	allocCounts[allocPhase].numFrees++;
+	count_heap_bytes(-(long long)malloc_usable_size(pointer));
+    }
+    __libc_free(pointer);
+}
+
+void start_alloc_profile(void) {
+    atexit(report_alloc_profile);
+}
+
+void report_alloc_profile(void) {
+    const char* phaseNames[NUM_ALLOC_PHASES] = ALLOC_PHASE_NAMES;
+    for (int phase = 0; phase < NUM_ALLOC_PHASES; phase++) {
+	AllocCounts* counts = &allocCounts[phase];
+	fprintf(stderr, "Alloc %s: allocs=%lld reallocs=%lld frees=%lld "
+		"bytes=%lld\n", phaseNames[phase], counts->numAllocs,
+		counts->numReallocs, counts->numFrees,
+		counts->bytesAllocated);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, "Alloc peak: heap=%lldB rss=%ldKB\n", peakHeapBytes,
+	    usage.ru_maxrss);
+}
+#else
+void start_alloc_profile(void) {
+    // Not compiled to profile allocations
+}
+
+void report_alloc_profile(void) {
+    // Nothing has been counted
+}
+#endif
@@ -0,0 +1,55 @@
+#ifndef DEALER_ALLOC_H
+#define DEALER_ALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Allocation profiling is a compile-time switch, i.e.
+ * make clean && make OPTFLAGS=-DALLOC_PROFILE. The dealer then replaces
+ * malloc(), calloc(), realloc() and free() (for the C library and plugins
+ * too), counting allocations and bytes by phase of the game, and reports
+ * them to stderr at exit, along with the peak heap and RSS. Otherwise,
+ * ALLOC_PHASE() compiles to nothing. */
+
+/* Phases of the dealer that allocations are counted by */
+typedef enum {
+    ALLOC_LOAD = 0,         // Reading and validating the deck and path
+    ALLOC_INIT = 1,         // Starting players and setting up the game
+    ALLOC_TURN = 2,         // Playing moves (other than displaying)
+    ALLOC_DISPLAY = 3,      // Displaying the game
+    ALLOC_TEARDOWN = 4,     // Scoring, and freeing the game and players
+    NUM_ALLOC_PHASES = 5
+} AllocPhase;
+
+/* Names of the phases in the report, in AllocPhase order */
+#define ALLOC_PHASE_NAMES {"load", "init", "turn", "display", "teardown"}
+
+#ifdef ALLOC_PROFILE
+/* Takes in the phase the dealer is entering. Counts allocations made from
+ * now on against said phase. */
+#define ALLOC_PHASE(phase) (allocPhase = (phase))
+#else
+#define ALLOC_PHASE(phase) ((void)0)
+#endif
+
+/* Allocation counts of one phase */
+typedef struct {
+    long long numAllocs;    // malloc() and calloc(), and realloc(NULL)
+    long long numReallocs;
+    long long numFrees;
+    long long bytesAllocated;
+} AllocCounts;
+
+/* Global variable - the phase allocations are currently counted against. */
+extern AllocPhase allocPhase;
+
+/* Starts profiling allocations (if compiled to do so), reporting the
+ * profile once the dealer exits. */
+void start_alloc_profile(void);
+
+/* Prints the allocations of each phase, along with the peak heap (the most
+ * bytes allocated at once) and peak RSS, to stderr. */
+void report_alloc_profile(void);
+
+#endif
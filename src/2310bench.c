@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "2310X.h"
+#include "2310bench.h"
+#include "2310pathgen.h"
+#include "2310latency.h"
+
+/* Number of allocations made so far, when the running timer was started,
+ * and while timed by the running microbenchmark. */
+static long long numAllocations = 0;
+static long long timerAllocations = 0;
+static long long timedAllocations = 0;
+
+int main(int argc, char** argv) {
+    BenchFormat format = FORMAT_CSV;
+    bool runMicro = true;
+    bool runMacro = true;
+    for (int arg = 1; arg < argc; arg++) {
+	if (!strcmp(argv[arg], BENCH_JSON_ARG)) {
+	    format = FORMAT_JSON;
+	} else if (!strcmp(argv[arg], BENCH_MICRO_ARG)) {
+	    runMacro = false;
+	} else if (!strcmp(argv[arg], BENCH_MACRO_ARG)) {
+	    runMicro = false;
+	} else {
+	    fprintf(stderr, "Usage: 2310bench [%s] [%s | %s]\n",
+		    BENCH_JSON_ARG, BENCH_MICRO_ARG, BENCH_MACRO_ARG);
+	    return EXIT_FAILURE;
+	}
+    }
+    if (format == FORMAT_CSV) {
+	printf("kind,benchmark,scale,iterations,ns_per_op,ops_per_sec,"
+		"allocs_per_op\n");
+    }
+    if (runMicro) {
+	run_micro_benchmarks(format);
+    }
+    if (runMacro && !run_macro_benchmarks(format)) {
+	return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+long long start_timer(void) {
+    timerAllocations = numAllocations;
+    return monotonic_time_ns();
+}
+
+long long stop_timer(long long start) {
+    long long elapsed = monotonic_time_ns() - start;
+    timedAllocations += numAllocations - timerAllocations;
+    return elapsed;
+}
+
+void* __wrap_malloc(size_t size) {
+    numAllocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    numAllocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    numAllocations++;
+    return __real_realloc(pointer, size);
+}
+
+void report_result(BenchResult* result, BenchFormat format) {
+    double nsPerOp = (double)result->elapsedNs / result->iterations;
+    double opsPerSec = nsPerOp > 0 ? NS_PER_SEC / nsPerOp : 0;
+    // Uncounted allocations are left empty (CSV) or null (JSON)
+    char allocsPerOp[INITIAL_BUFFER_SIZE] = "";
+    if (result->allocations != ALLOCATIONS_NOT_COUNTED) {
+	snprintf(allocsPerOp, INITIAL_BUFFER_SIZE, "%.2f",
+		(double)result->allocations / result->iterations);
+    }
+    if (format == FORMAT_JSON) {
+	printf("{\"kind\": \"%s\", \"benchmark\": \"%s\", \"scale\": %d, "
+		"\"iterations\": %lld, \"ns_per_op\": %.1f, "
+		"\"ops_per_sec\": %.1f, \"allocs_per_op\": %s}\n",
+		result->kind, result->name, result->scale, result->iterations,
+		nsPerOp, opsPerSec, allocsPerOp[0] ? allocsPerOp : "null");
+    } else {
+	printf("%s,%s,%d,%lld,%.1f,%.1f,%s\n", result->kind, result->name,
+		result->scale, result->iterations, nsPerOp, opsPerSec,
+		allocsPerOp);
+    }
+    fflush(stdout);
+}
+
+void run_micro_benchmarks(BenchFormat format) {
+    MicroBenchmark benchmarks[] = {
+	{"get_line", bench_get_line},
+	{"validate_path", bench_validate_path},
+	{"decode_hap_message", bench_decode_hap_message},
+	{"process_hap_details", bench_process_hap_details},
+	{"display_game", bench_display_game},
+	{"calculate_whose_turn", bench_calculate_whose_turn},
+	{"check_barrier_skipped", bench_check_barrier_skipped},
+	{"calculate_score_from_cards", bench_calculate_score_from_cards}
+    };
+    int scales[NUM_BENCH_SCALES] = BENCH_SCALES;
+    int numBenchmarks = sizeof(benchmarks) / sizeof(MicroBenchmark);
+
+    // display_game() displays to stderr, as players do. Discard it.
+    int savedStderr = dup(STDERR_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDERR_FILENO);
+    close(devNull);
+
+    for (int bench = 0; bench < numBenchmarks; bench++) {
+	for (int scale = 0; scale < NUM_BENCH_SCALES; scale++) {
+	    BenchResult result = {.kind = "micro",
+		    .name = benchmarks[bench].name, .scale = scales[scale],
+		    .iterations = 1, .elapsedNs = 0, .allocations = 0};
+	    while (timedAllocations = 0, (result.elapsedNs =
+		    benchmarks[bench].run(scales[scale], result.iterations))
+		    < BENCH_MIN_NS) {
+		result.iterations *= 2;
+	    }
+	    result.allocations = timedAllocations;
+	    report_result(&result, format);
+	}
+    }
+    dup2(savedStderr, STDERR_FILENO);
+    close(savedStderr);
+}
+
+char* create_bench_path(int numSites) {
+    PathSettings settings;
+    init_path_settings(&settings, numSites);
+    settings.limit = BENCH_SITE_LIMIT;
+    settings.barrierPercent = BENCH_BARRIER_PERCENT;
+    char* path = NULL;
+    size_t pathSize = 0;
+    FILE* pathOutput = open_memstream(&path, &pathSize);
+    write_path(pathOutput, &settings, BENCH_PATH_SEED);
+    fclose(pathOutput);
+    return path;
+}
+
+Game* generate_game(int numSites, char** path) {
+    *path = create_bench_path(numSites);
+    Game* game = init_game(*path, BENCH_PLAYERS);
+    game->displayEnabled = false;
+    return game;
+}
+
+void choose_next_move(Game* game, HapDetails* move) {
+    Player* movingPlayer = game->players[calculate_whose_turn(game)];
+    int newSite = movingPlayer->currentSite + 1;
+    while (check_site_full(game, newSite)) {
+	newSite++;
+    }
+    move->playerID = movingPlayer->playerID;
+    move->newSite = newSite;
+    move->additionalPoints = 0;
+    move->moneyChange = 0;
+    move->cardDrawn = 0;
+}
+
+void make_next_move(Game* game) {
+    HapDetails move;
+    choose_next_move(game, &move);
+    process_hap_details(game, &move, true);
+}
+
+long long bench_get_line(int scale, long long iterations) {
+    char* path = create_bench_path(scale);
+    FILE* pathSource = fmemopen(path, strlen(path), "r");
+    size_t lineLength = INITIAL_BUFFER_SIZE;
+    char* line = (char*)malloc(lineLength * sizeof(char));
+
+    long long start = start_timer();
+    for (long long i = 0; i < iterations; i++) {
+	rewind(pathSource);
+	get_line(&line, &lineLength, pathSource);
+    }
+    long long elapsed = stop_timer(start);
+    fclose(pathSource);
+    free(line);
+    free(path);
+    return elapsed;
+}
+
+long long bench_validate_path(int scale, long long iterations) {
+    char* path = create_bench_path(scale);
+    FILE* pathSource = fmemopen(path, strlen(path), "r");
+    size_t pathLength = INITIAL_BUFFER_SIZE;
+    char* validatedPath = (char*)malloc(pathLength * sizeof(char));
+
+    long long start = start_timer();
+    for (long long i = 0; i < iterations; i++) {
+	rewind(pathSource);
+	validate_path(&validatedPath, &pathLength, pathSource, true);
+    }
+    long long elapsed = stop_timer(start);
+    fclose(pathSource);
+    free(validatedPath);
+    free(path);
+    return elapsed;
+}
+
+long long bench_decode_hap_message(int scale, long long iterations) {
+    // Player 0 moves first, and may move to the first site
+    char* path = NULL;
+    Game* game = generate_game(scale, &path);
+    char hapMessage[] = "HAP0,1,0,3,0";
+    HapDetails move;
+
+    long long start = start_timer();
+    for (long long i = 0; i < iterations; i++) {
+	decode_hap_message(game, hapMessage, &move);
+    }
+    long long elapsed = stop_timer(start);
+    free_game(game, path);
+    return elapsed;
+}
+
+long long bench_process_hap_details(int scale, long long iterations) {
+    // Each iteration is one move. The moves of a whole game are chosen up
+    // front, so that only applying them is timed.
+    char* path = NULL;
+    Game* game = generate_game(scale, &path);
+    int movesMax = scale;
+    int numMoves = 0;
+    HapDetails* moves = (HapDetails*)malloc(movesMax * sizeof(HapDetails));
+    while (game->rearmostSite != game->path->numSites - 1) {
+	if (numMoves == movesMax) {
+	    movesMax *= 2;
+	    moves = (HapDetails*)realloc(moves, movesMax *
+		    sizeof(HapDetails));
+	}
+	choose_next_move(game, &moves[numMoves]);
+	process_hap_details(game, &moves[numMoves++], true);
+    }
+    free_game(game, path);
+
+    // The same game is played again (on a fresh game) as often as needed
+    long long elapsed = 0;
+    long long movesMade = 0;
+    while (movesMade < iterations) {
+	game = generate_game(scale, &path);
+	long long start = start_timer();
+	for (int move = 0; move < numMoves && movesMade < iterations;
+		move++, movesMade++) {
+	    process_hap_details(game, &moves[move], true);
+	}
+	elapsed += stop_timer(start);
+	free_game(game, path);
+    }
+    free(moves);
+    return elapsed;
+}
+
+long long bench_display_game(int scale, long long iterations) {
+    // Display a game part way through, with players spread out
+    char* path = NULL;
+    Game* game = generate_game(scale, &path);
+    for (int move = 0; move < scale; move++) {
+	make_next_move(game);
+    }
+    game->displayEnabled = true;
+
+    long long start = start_timer();
+    for (long long i = 0; i < iterations; i++) {
+	display_game(game, true);
+    }
+    long long elapsed = stop_timer(start);
+    free_game(game, path);
+    return elapsed;
+}
+
+long long bench_calculate_whose_turn(int scale, long long iterations) {
+    char* path = NULL;
+    Game* game = generate_game(scale, &path);
+    for (int move = 0; move < scale; move++) {
+	make_next_move(game);
+    }
+    volatile int whoseTurn = INVALID_PLAYER_ID;
+
+    long long start = start_timer();
+    for (long long i = 0; i < iterations; i++) {
+	whoseTurn = calculate_whose_turn(game);
+    }
+    long long elapsed = stop_timer(start);
+    (void)whoseTurn;
+    free_game(game, path);
+    return elapsed;
+}
+
+long long bench_check_barrier_skipped(int scale, long long iterations) {
+    // Player 0 is at the first site, and tries moving to every other site
+    char* path = NULL;
+    Game* game = generate_game(scale, &path);
+    volatile bool barrierSkipped = false;
+
+    long long start = start_timer();
+    for (long long i = 0; i < iterations; i++) {
+	barrierSkipped = check_barrier_skipped(game, game->players[0],
+		i % game->path->numSites);
+    }
+    long long elapsed = stop_timer(start);
+    (void)barrierSkipped;
+    free_game(game, path);
+    return elapsed;
+}
+
+long long bench_calculate_score_from_cards(int scale, long long iterations) {
+    // Scoring uses up the player's cards, so they are dealt again each
+    // iteration
+    Player player;
+    memset(&player, 0, sizeof(Player));
+
+    long long start = start_timer();
+    for (long long i = 0; i < iterations; i++) {
+	for (int cardType = 0; cardType < NUM_CARD_TYPES; cardType++) {
+	    player.numCards[cardType] = scale - cardType;
+	}
+	player.numPoints = 0;
+	calculate_score_from_cards(&player);
+    }
+    return stop_timer(start);
+}
+
+bool run_macro_benchmarks(BenchFormat format) {
+    // Game files for the dealer, in a fresh directory
+    char gameDir[] = "/tmp/2310benchXXXXXX";
+    if (!mkdtemp(gameDir)) {
+	return false;
+    }
+    char deckFile[sizeof(gameDir) + INITIAL_BUFFER_SIZE];
+    char pathFile[sizeof(gameDir) + INITIAL_BUFFER_SIZE];
+    char processRequests[sizeof(gameDir) + INITIAL_BUFFER_SIZE];
+    char pluginRequests[sizeof(gameDir) + INITIAL_BUFFER_SIZE];
+    sprintf(deckFile, "%s/deck", gameDir);
+    sprintf(pathFile, "%s/path", gameDir);
+    sprintf(processRequests, "%s/processes", gameDir);
+    sprintf(pluginRequests, "%s/plugins", gameDir);
+
+    FILE* deck = fopen(deckFile, "w");
+    FILE* path = fopen(pathFile, "w");
+    FILE* processes = fopen(processRequests, "w");
+    FILE* plugins = fopen(pluginRequests, "w");
+    char* generatedPath = create_bench_path(MACRO_SITES);
+    if (deck && path && processes && plugins) {
+	fprintf(deck, "10ABCDEEDCBA\n");
+	fprintf(path, "%s\n", generatedPath);
+	for (int game = 0; game < MACRO_GAMES; game++) {
+	    fprintf(processes, "%s %s ./2310A ./2310B ./2310A ./2310B\n",
+		    deckFile, pathFile);
+	    fprintf(plugins, "%s %s ./2310A.so ./2310B.so ./2310A.so "
+		    "./2310B.so\n", deckFile, pathFile);
+	}
+    }
+    free(generatedPath);
+    bool created = deck && path && processes && plugins;
+    FILE* files[] = {deck, path, processes, plugins};
+    for (int file = 0; file < sizeof(files) / sizeof(FILE*); file++) {
+	if (files[file]) {
+	    fclose(files[file]);
+	}
+    }
+
+    if (created) {
+	// The dealer (and players) are run from the current directory
+	char command[4 * sizeof(gameDir) + 4 * INITIAL_BUFFER_SIZE];
+	sprintf(command, "for game in $(seq %d); do ./2310dealer %s %s "
+		"./2310A ./2310B ./2310A ./2310B; done > /dev/null",
+		MACRO_DEALER_GAMES, deckFile, pathFile);
+	time_games("dealer_processes", command, MACRO_DEALER_GAMES, format);
+	sprintf(command, "./2310dealer --server < %s > /dev/null",
+		processRequests);
+	time_games("server_processes", command, MACRO_GAMES, format);
+	sprintf(command, "ZYGOTE_PLAYER=1 ./2310dealer --server < %s "
+		"> /dev/null", processRequests);
+	time_games("server_zygotes", command, MACRO_GAMES, format);
+	sprintf(command, "./2310dealer --server < %s > /dev/null",
+		pluginRequests);
+	time_games("server_plugins", command, MACRO_GAMES, format);
+    }
+    unlink(deckFile);
+    unlink(pathFile);
+    unlink(processRequests);
+    unlink(pluginRequests);
+    rmdir(gameDir);
+    return created;
+}
+
+void time_games(const char* name, const char* command, int numGames,
+	BenchFormat format) {
+    long long start = start_timer();
+    int status = system(command);
+    BenchResult result = {.kind = "macro", .name = name,
+	    .scale = MACRO_SITES, .iterations = numGames,
+	    .elapsedNs = monotonic_time_ns() - start,
+	    .allocations = ALLOCATIONS_NOT_COUNTED};
+    if (status) {
+	fprintf(stderr, "%s: games did not finish normally\n", name);
+	return;
+    }
+    report_result(&result, format);
+}
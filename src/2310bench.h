@@ -0,0 +1,144 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "2310X.h"
+#include "2310pathgen.h"
+#include "2310latency.h"
+
+/* Command-line arguments of the benchmark program, i.e.
+ * 2310bench [--json] [--micro | --macro]. By default both the micro and the
+ * macro benchmarks are run, and results are printed as CSV. */
+#define BENCH_JSON_ARG "--json"
+#define BENCH_MICRO_ARG "--micro"
+#define BENCH_MACRO_ARG "--macro"
+
+/* Each microbenchmark is repeated (doubling the number of iterations) until
+ * it has run for at least this long, in nanoseconds. */
+#define BENCH_MIN_NS 200000000LL
+
+/* Number of nanoseconds in a second */
+#define NS_PER_SEC 1000000000LL
+
+/* Number of scales each microbenchmark is run at, and the scales themselves
+ * (the number of sites in the path, or cards held for scoring). */
+#define NUM_BENCH_SCALES 3
+#define BENCH_SCALES {100, 1000, 10000}
+
+/* Number of players in the games used by the microbenchmarks */
+#define BENCH_PLAYERS 8
+
+/* Paths benchmarked are generated (see write_path()) with this seed, and
+ * this limit for every site, so that some sites fill up, and this percentage
+ * of barriers */
+#define BENCH_PATH_SEED 0
+#define BENCH_SITE_LIMIT 2
+#define BENCH_BARRIER_PERCENT 15
+
+/* Games played by each end-to-end benchmark, and the number of sites in the
+ * path they are played on. Starting the single-game dealer costs a process
+ * per game, hence it plays fewer games. */
+#define MACRO_GAMES 400
+#define MACRO_DEALER_GAMES 50
+#define MACRO_SITES 50
+
+/* Allocation count of a result whose allocations are not counted, i.e. the
+ * macro benchmarks, whose allocations happen in other processes. */
+#define ALLOCATIONS_NOT_COUNTED (-1)
+
+/* Output format of the results */
+typedef enum {
+    FORMAT_CSV = 0,
+    FORMAT_JSON = 1
+} BenchFormat;
+
+/* Result of one benchmark */
+typedef struct {
+    const char* kind; // "micro" or "macro"
+    const char* name;
+    int scale;
+    long long iterations;
+    long long elapsedNs;
+    long long allocations; // Made while timed, or ALLOCATIONS_NOT_COUNTED
+} BenchResult;
+
+/* Benchmark representation. run() takes in the scale and the number of
+ * iterations, and returns the nanoseconds taken to run said iterations
+ * (excluding any set up). */
+typedef struct {
+    const char* name;
+    long long (*run)(int scale, long long iterations);
+} MicroBenchmark;
+
+/* Starts timing part of a microbenchmark. Returns the start time, to be
+ * passed to stop_timer(). */
+long long start_timer(void);
+
+/* Takes in the time returned by start_timer(). Adds the allocations made
+ * since then to those of the running microbenchmark. Returns the
+ * nanoseconds elapsed since said time. */
+long long stop_timer(long long start);
+
+/* The benchmark is linked with --wrap for each of malloc(), calloc() and
+ * realloc(), so that calls from the game functions come through these. Each
+ * counts the allocation and passes it on to the real function. */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* pointer, size_t size);
+
+/* Takes in a result and the output format. Prints the result as one CSV
+ * row or one JSON object (per line). */
+void report_result(BenchResult* result, BenchFormat format);
+
+/* Takes in the output format. Runs every microbenchmark at every scale and
+ * reports the results. */
+void run_micro_benchmarks(BenchFormat format);
+
+/* Takes in the output format. Times whole games played by the dealer, both
+ * with player processes and in-process plugin players, and reports the
+ * results. Returns false if the game files could not be created. */
+bool run_macro_benchmarks(BenchFormat format);
+
+/* Takes in the number of sites. Returns a valid path (as sent to players,
+ * without the newline) of said length, generated by write_path(). */
+char* create_bench_path(int numSites);
+
+/* Takes in the number of sites and a pointer to store the generated path
+ * in. Returns a new game of BENCH_PLAYERS players on a generated path of said
+ * length, with display disabled. */
+Game* generate_game(int numSites, char** path);
+
+/* Takes in a game that is not over, and an empty HapDetails. Chooses a move
+ * for the player whose turn it is, to the nearest site in front of them with
+ * room (barriers always have room), and stores it in the HapDetails. */
+void choose_next_move(Game* game, HapDetails* move);
+
+/* Takes in a game that is not over. Makes the move chosen by
+ * choose_next_move(). */
+void make_next_move(Game* game);
+
+/* Microbenchmarks. Each takes in the scale and the number of iterations, and
+ * returns the nanoseconds taken. Only the code between start_timer() and
+ * stop_timer() is timed (and has its allocations counted). */
+long long bench_get_line(int scale, long long iterations);
+long long bench_validate_path(int scale, long long iterations);
+long long bench_decode_hap_message(int scale, long long iterations);
+long long bench_process_hap_details(int scale, long long iterations);
+long long bench_display_game(int scale, long long iterations);
+long long bench_calculate_whose_turn(int scale, long long iterations);
+long long bench_check_barrier_skipped(int scale, long long iterations);
+long long bench_calculate_score_from_cards(int scale, long long iterations);
+
+/* Takes in the name of the benchmark, the shell command that plays the
+ * games, the number of games, and the output format. Times said command and
+ * reports the time per game (and games per second). */
+void time_games(const char* name, const char* command, int numGames,
+	BenchFormat format);
+
+#endif
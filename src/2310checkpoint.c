@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "2310checkpoint.h"
+#include "2310gamelog.h"
+#include "2310latency.h"
+#include "2310X.h"
+
+/* Global variable - whether the game is being checkpointed. */
+bool checkpointing = false;
+
+/* Global variable - the checkpoints of the game, if any. */
+Checkpoints checkpoints;
+
+void start_checkpoints(char* fileName, char* deck, char* path,
+	int playerCount, char** programs) {
+    if (!fileName) {
+	return;
+    }
+    checkpoints.fileName = fileName;
+    checkpoints.tempFileName = (char*)malloc((strlen(fileName) +
+	    strlen(CHECKPOINT_TEMP_SUFFIX) + 1) * sizeof(char));
+    sprintf(checkpoints.tempFileName, "%s%s", fileName,
+	    CHECKPOINT_TEMP_SUFFIX);
+    checkpoints.deckHash = hash_text(deck);
+    checkpoints.pathHash = hash_text(path);
+    checkpoints.deckLength = strtol(deck, NULL, 10);
+
+    checkpoints.lineupLength = 0;
+    for (int player = 0; player < playerCount; player++) {
+	checkpoints.lineupLength += strlen(programs[player]) + 1;
+    }
+    checkpoints.lineup = (char*)malloc(checkpoints.lineupLength *
+	    sizeof(char));
+    size_t lineupLength = 0;
+    for (int player = 0; player < playerCount; player++) {
+	strcpy(checkpoints.lineup + lineupLength, programs[player]);
+	lineupLength += strlen(programs[player]) + 1;
+    }
+    checkpoints.state = NULL; // Sized once the game is known
+    checkpoints.lastWritten = monotonic_time_ns();
+    checkpointing = true;
+}
+
+bool checkpoint_game(Game* game, bool force) {
+    if (!checkpointing) {
+	return true;
+    }
+    long long now = monotonic_time_ns();
+    if (!force && now - checkpoints.lastWritten <
+	    (long long)CHECKPOINT_INTERVAL_MS * NS_PER_US * US_PER_MS) {
+	return true;
+    }
+    checkpoints.lastWritten = now;
+    if (!checkpoints.state) {
+	checkpoints.state = (char*)malloc(state_message_size(game) *
+		sizeof(char));
+    }
+    // The newline is left out, as the message is stored as a string
+    int stateLength = create_state_message(game, checkpoints.state) - 1;
+
+    int numCardsDrawn = 0;
+    for (int player = 0; player < game->playerCount; player++) {
+	numCardsDrawn += game->players[player]->totalCards;
+    }
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(CheckpointHeader));
+    memcpy(header.magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_SIZE);
+    header.version = CHECKPOINT_VERSION;
+    header.playerCount = game->playerCount;
+    header.numMoves = game->numMoves;
+    header.deckCursor = numCardsDrawn % checkpoints.deckLength;
+    header.stateLength = stateLength;
+    header.lineupLength = checkpoints.lineupLength;
+    header.deckHash = checkpoints.deckHash;
+    header.pathHash = checkpoints.pathHash;
+
+    // Written in full before replacing the previous checkpoint
+    struct iovec parts[] = {
+	    {.iov_base = &header, .iov_len = sizeof(CheckpointHeader)},
+	    {.iov_base = checkpoints.state, .iov_len = stateLength},
+	    {.iov_base = checkpoints.lineup,
+		    .iov_len = checkpoints.lineupLength}};
+    ssize_t checkpointLength = sizeof(CheckpointHeader) + stateLength +
+	    checkpoints.lineupLength;
+    int checkpointFd = open(checkpoints.tempFileName,
+	    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (checkpointFd == -1) {
+	return false;
+    }
+    bool written = writev(checkpointFd, parts, sizeof(parts) /
+	    sizeof(struct iovec)) == checkpointLength;
+    close(checkpointFd);
+    return written && !rename(checkpoints.tempFileName,
+	    checkpoints.fileName);
+}
+
+void finish_checkpoints(bool gameOver) {
+    if (!checkpointing) {
+	return;
+    }
+    // A finished game has nothing left to resume
+    if (gameOver) {
+	unlink(checkpoints.fileName);
+    }
+    unlink(checkpoints.tempFileName);
+    free(checkpoints.tempFileName);
+    free(checkpoints.lineup);
+    free(checkpoints.state);
+    checkpointing = false;
+}
+
+Checkpoint* load_checkpoint(char* fileName, char* dealerProgram,
+	char* deckFileName, char* pathFileName) {
+    FILE* checkpointFile = fopen(fileName, "r");
+    if (!checkpointFile) {
+	return NULL;
+    }
+    Checkpoint* checkpoint = (Checkpoint*)calloc(1, sizeof(Checkpoint));
+    CheckpointHeader* header = &checkpoint->header;
+    struct stat checkpointStat;
+    bool valid = !fstat(fileno(checkpointFile), &checkpointStat) &&
+	    fread(header, sizeof(CheckpointHeader), 1, checkpointFile) ==
+	    1 && !memcmp(header->magic, CHECKPOINT_MAGIC,
+	    CHECKPOINT_MAGIC_SIZE) &&
+	    header->version == CHECKPOINT_VERSION &&
+	    header->playerCount > 0 &&
+	    header->playerCount <= header->lineupLength / 2 &&
+	    (off_t)sizeof(CheckpointHeader) + header->stateLength +
+	    header->lineupLength == checkpointStat.st_size;
+    if (valid) {
+	checkpoint->state = (char*)malloc((header->stateLength + 1) *
+		sizeof(char));
+	checkpoint->lineup = (char*)malloc((header->lineupLength + 1) *
+		sizeof(char));
+	valid = fread(checkpoint->state, sizeof(char), header->stateLength,
+		checkpointFile) == header->stateLength &&
+		fread(checkpoint->lineup, sizeof(char), header->lineupLength,
+		checkpointFile) == header->lineupLength;
+    }
+    fclose(checkpointFile);
+    if (!valid) {
+	free_checkpoint(checkpoint);
+	return NULL;
+    }
+    checkpoint->state[header->stateLength] = '\0';
+    checkpoint->lineup[header->lineupLength] = '\0';
+    checkpoint->fileName = fileName;
+
+    // First 3 arguments are the dealer program, and the deck and path files
+    checkpoint->argc = header->playerCount + 3;
+    checkpoint->argv = (char**)malloc((checkpoint->argc + 1) *
+	    sizeof(char*));
+    checkpoint->argv[0] = dealerProgram;
+    checkpoint->argv[1] = deckFileName;
+    checkpoint->argv[2] = pathFileName;
+    size_t lineupLength = 0;
+    for (int player = 0; player < header->playerCount; player++) {
+	// Each player program must be at least one character
+	if (lineupLength >= header->lineupLength ||
+		!checkpoint->lineup[lineupLength]) {
+	    free_checkpoint(checkpoint);
+	    return NULL;
+	}
+	checkpoint->argv[player + 3] = checkpoint->lineup + lineupLength;
+	lineupLength += strlen(checkpoint->lineup + lineupLength) + 1;
+    }
+    checkpoint->argv[checkpoint->argc] = NULL;
+    if (lineupLength != header->lineupLength) {
+	free_checkpoint(checkpoint);
+	return NULL;
+    }
+    return checkpoint;
+}
+
+bool checkpoint_matches(Checkpoint* checkpoint, char* deck, char* path) {
+    CheckpointHeader* header = &checkpoint->header;
+    if (hash_text(deck) != header->deckHash ||
+	    hash_text(path) != header->pathHash) {
+	return false;
+    }
+    // The state is checked against a new game of the path
+    char* pathCopy = strdup(path);
+    Game* game = init_game(pathCopy, header->playerCount);
+    bool matches = state_message_valid(game, checkpoint->state);
+    if (matches) {
+	apply_state_message(game, checkpoint->state);
+	int numCardsDrawn = 0;
+	for (int player = 0; player < game->playerCount; player++) {
+	    numCardsDrawn += game->players[player]->totalCards;
+	}
+	matches = game->numMoves == header->numMoves &&
+		numCardsDrawn % strtol(deck, NULL, 10) ==
+		header->deckCursor;
+    }
+    free_game(game, pathCopy);
+    return matches;
+}
+
+void free_checkpoint(Checkpoint* checkpoint) {
+    if (!checkpoint) {
+	return;
+    }
+    free(checkpoint->state);
+    free(checkpoint->lineup);
+    free(checkpoint->argv);
+    free(checkpoint);
+}
@@ -0,0 +1,137 @@
+#ifndef DEALER_CHECKPOINT_H
+#define DEALER_CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "2310X.h"
+
+/* If this environment variable is set, the dealer saves the state of its
+ * game to the file it names every CHECKPOINT_INTERVAL_MS (and once more if
+ * the game ends early), so that a game cut short (e.g. by a player crashing)
+ * can be carried on with:
+ *   2310dealer --resume checkpoint deck path
+ * The players are taken from the checkpoint. Each is started afresh and,
+ * once given the path, is brought up to date with a single STATE message
+ * (see create_state_message()) rather than every move made so far. A
+ * resumed game carries on checkpointing to the file it was resumed from
+ * (whether or not this variable is set). The checkpoint is removed once the
+ * game is over.
+ *
+ * A checkpoint is a CheckpointHeader, followed by the STATE message
+ * (stateLength chars, without the newline) and the lineup (lineupLength
+ * chars: each player program, null-terminated). All values are in the byte
+ * order of the machine that wrote them. */
+#define CHECKPOINT_ENV "DEALER_CHECKPOINT"
+#define RESUME_MODE_ARG "--resume"
+
+/* Number of command line args of the dealer when resuming a game */
+#define RESUME_NUM_CMD_LINE_ARGS 5
+
+/* Identifies a checkpoint (including the null terminator), and the version of
+ * the checkpoint format */
+#define CHECKPOINT_MAGIC "2310CKP"
+#define CHECKPOINT_MAGIC_SIZE 8
+#define CHECKPOINT_VERSION 1
+
+/* How often (in milliseconds) the game in progress is saved */
+#define CHECKPOINT_INTERVAL_MS 1000
+
+/* A checkpoint is written to its file name with this appended, then renamed
+ * over the previous checkpoint, so that a checkpoint is never left half
+ * written. */
+#define CHECKPOINT_TEMP_SUFFIX ".tmp"
+
+/* Header of a checkpoint */
+typedef struct {
+    char magic[CHECKPOINT_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t playerCount;
+
+    // Number of moves made, and the index of the next card to be drawn
+    uint32_t numMoves;
+    uint32_t deckCursor;
+
+    // Lengths of the STATE message and lineup that follow the header
+    uint32_t stateLength;
+    uint32_t lineupLength;
+
+    // Hashes (see hash_text()) of the deck and path file contents
+    uint64_t deckHash;
+    uint64_t pathHash;
+} CheckpointHeader;
+
+/* A loaded checkpoint */
+typedef struct {
+    CheckpointHeader header;
+
+    // The STATE message (without the newline), and the command-line
+    // arguments the game was started with (the dealer program, the deck and
+    // path files, then the players from the lineup, and NULL)
+    char* state;
+    char** argv;
+    int argc;
+
+    // The lineup (which argv points into)
+    char* lineup;
+
+    // Name of the file the checkpoint was loaded from
+    char* fileName;
+} Checkpoint;
+
+/* Checkpoints of the game in progress */
+typedef struct {
+    char* fileName;
+    char* tempFileName;
+
+    // Hashes of the deck and path, and the number of cards in the deck
+    uint64_t deckHash;
+    uint64_t pathHash;
+    int deckLength;
+
+    // The lineup (each player program, null-terminated) and its length
+    char* lineup;
+    size_t lineupLength;
+
+    // Buffer the STATE message is formed in, and when the last checkpoint
+    // was written
+    char* state;
+    long long lastWritten;
+} Checkpoints;
+
+/* Global variable - whether the game is being checkpointed. */
+extern bool checkpointing;
+
+/* Takes in the name of the file to checkpoint to (NULL if the game is not to
+ * be checkpointed), the (validated) deck and path, the player count and the
+ * player programs. Starts checkpointing the game. */
+void start_checkpoints(char* fileName, char* deck, char* path,
+	int playerCount, char** programs);
+
+/* Takes in the game representation, and whether a checkpoint must be
+ * written now (e.g. as the game is ending early). Writes a checkpoint of the
+ * game if checkpointing and one is due. Returns false if a checkpoint could
+ * not be written. */
+bool checkpoint_game(Game* game, bool force);
+
+/* Takes in whether the game is over (i.e. ended normally). Stops
+ * checkpointing, removing the checkpoint if the game is over. */
+void finish_checkpoints(bool gameOver);
+
+/* Takes in the name of a checkpoint file, and the dealer program, deck file
+ * and path file to resume the game with. Returns the checkpoint, or NULL if
+ * it cannot be read or is malformed. */
+Checkpoint* load_checkpoint(char* fileName, char* dealerProgram,
+	char* deckFileName, char* pathFileName);
+
+/* Takes in a loaded checkpoint, and the (validated) deck and path. Returns
+ * if the checkpoint is of a game with said deck and path, and its state can
+ * be applied to a new game of said path. */
+bool checkpoint_matches(Checkpoint* checkpoint, char* deck, char* path);
+
+/* Takes in a loaded checkpoint (or NULL). Frees it. */
+void free_checkpoint(Checkpoint* checkpoint);
+
+#endif
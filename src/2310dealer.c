@@ -1,3 +1,6 @@
+/* pipe2() is a GNU extension */
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,9 +12,28 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <time.h>
 #include "dealerErrors.h"
 #include "2310dealer.h"
 #include "2310X.h"
+#include "2310io.h"
+#include "2310latency.h"
+#include "2310trace.h"
+#include "2310alloc.h"
+#include "2310profile.h"
+#include "2310gamelog.h"
+#include "2310checkpoint.h"
+#include "2310plugin.h"
+#include "2310server.h"
+
+/* Global list - Stores the zygote of each player program used so far. */
+Zygote* zygotes = NULL;
 
 /* Global array - Stores PIDs of child processes. */
 pid_t* childrenIDs;
@@ -19,56 +41,125 @@ pid_t* childrenIDs;
 /* Global variable - stores length of childrenIDs array. */
 int numChildren;
 
+/* Global array - Stores the resource usage of each reaped player process. */
+struct rusage* childrenUsage;
+
+/* Global array - Stores whether each player process has been reaped. */
+volatile sig_atomic_t* childrenReaped;
+
 int main(int argc, char** argv) {
+    start_sampling_profiler(); // Only if asked to, see 2310profile.h
+
+    // Host many games at once, as requested on stdin
+    if (argc == 2 && !strcmp(argv[1], SERVER_MODE_ARG)) {
+	return run_server();
+    }
+    // A resumed game is played by the players it was saved with
+    Checkpoint* checkpoint = NULL;
+    if (argc == RESUME_NUM_CMD_LINE_ARGS &&
+	    !strcmp(argv[1], RESUME_MODE_ARG)) {
+	checkpoint = load_checkpoint(argv[2], argv[0], argv[3], argv[4]);
+	if (!checkpoint) {
+	    return dealer_error_message(DEALER_CHECKPOINT);
+	}
+	argc = checkpoint->argc;
+	argv = checkpoint->argv;
+    }
     if (argc < MIN_NUM_CMD_LINE_ARGS) {
 	return dealer_error_message(DEALER_ARGS);
     }
-    FILE* deckFile = fopen(argv[1], "r");
+    start_alloc_profile();
+    char* deck = NULL;
+    char* path = NULL;
+    DealerExitCodes loadError = load_game_files(argv[1], argv[2], &deck,
+	    &path);
+    if (loadError != DEALER_NORMAL) {
+	free_checkpoint(checkpoint);
+	return dealer_error_message(loadError);
+    }
+    if (checkpoint && !checkpoint_matches(checkpoint, deck, path)) {
+	free(deck);
+	free(path);
+	free_checkpoint(checkpoint);
+	return dealer_error_message(DEALER_CHECKPOINT);
+    }
+    // First 3 arguments are the dealer program, and the deck and path files
+    int playerCount = argc - 3;
+    ALLOC_PHASE(ALLOC_INIT);
+    setup_signal_handling(playerCount); // Setup sigaction
+    setup_child_reaping(playerCount);
+    start_trace(getenv(TRACE_FILE_ENV), playerCount);
+
+    // A resumed game is checkpointed to where it was resumed from
+    start_checkpoints(checkpoint ? checkpoint->fileName :
+	    getenv(CHECKPOINT_ENV), deck, path, playerCount, argv + 3);
+
+    // The game is logged from when its files have loaded. A resumed game's
+    // earlier moves are not known, so it cannot be logged.
+    GameLog* log = checkpoint ? NULL : start_game_log(SINGLE_GAME_NUMBER,
+	    deck, path, playerCount, argv + 3);
+    DealerExitCodes gameError = start_game(deck, path, playerCount, argv,
+	    log, checkpoint ? checkpoint->state : NULL);
+    if (gameError != DEALER_NORMAL && !finish_game_log(log, NULL,
+	    gameError)) {
+	fprintf(stderr, "Unable to write game log to %s\n",
+		getenv(GAME_LOG_ENV));
+    }
+    finish_checkpoints(gameError == DEALER_NORMAL);
+    free_checkpoint(checkpoint);
+    free(deck); // path free'd in control_game() (called by start_game())
+    long long teardownStart = TRACE_START();
+    close_zygotes();
+    TRACE_SPAN("close zygotes", TRACE_DEALER, teardownStart,
+	    monotonic_time_ns());
+    // The game itself is unaffected, so only report the trace is missing
+    if (!write_trace()) {
+	fprintf(stderr, "Unable to write trace to %s\n",
+		getenv(TRACE_FILE_ENV));
+    }
+    free(childrenIDs); // If SIGHUP is not received, free
+    free(childrenUsage);
+    free((sig_atomic_t*)childrenReaped);
+    return dealer_error_message(gameError);
+}
+
+DealerExitCodes load_game_files(char* deckFileName, char* pathFileName,
+	char** deck, char** path) {
+    FILE* deckFile = fopen(deckFileName, "r");
     if (!deckFile) {
-	return dealer_error_message(DEALER_DECK);
+	return DEALER_DECK;
     }
     size_t deckLength = INITIAL_BUFFER_SIZE;
-    char* deck = (char*)malloc(deckLength * sizeof(char));
+    *deck = (char*)malloc(deckLength * sizeof(char));
 
     // validate deck
-    DealerExitCodes deckError = validate_deck(&deck, &deckLength, deckFile);
+    DealerExitCodes deckError = validate_deck(deck, &deckLength, deckFile);
+    fclose(deckFile);
     if (deckError != DEALER_NORMAL) {
-	fclose(deckFile); // validate_deck frees deck in case of error
-	return dealer_error_message(deckError);
+	return deckError; // validate_deck frees deck in case of error
     }
-    FILE* pathFile = fopen(argv[2], "r");
+    FILE* pathFile = fopen(pathFileName, "r");
     if (!pathFile) {
-	fclose(deckFile);
-	free(deck);
-	return dealer_error_message(DEALER_PATH);
+	free(*deck);
+	return DEALER_PATH;
     }
     size_t pathLength = INITIAL_BUFFER_SIZE;
-    char* path = (char*)malloc(pathLength * sizeof(char));
+    *path = (char*)malloc(pathLength * sizeof(char));
     
     // Used to differentiate who called a function that both the dealer and
     // player can call
     bool playerCalled = false;
 
     // validate path
-    DealerExitCodes pathError = validate_path(&path, &pathLength, pathFile,
+    DealerExitCodes pathError = validate_path(path, &pathLength, pathFile,
 	    playerCalled);
+    fclose(pathFile);
     if (pathError != DEALER_NORMAL) {
-	fclose(pathFile);
-	fclose(deckFile);
-	free(path);
-	free(deck);
-	return dealer_error_message(pathError);
+	free(*path);
+	free(*deck);
+	return pathError;
     }
-    // First 3 arguments are the dealer program, and the deck and path files
-    int playerCount = argc - 3;
-    setup_signal_handling(playerCount); // Setup sigaction
-
-    DealerExitCodes gameError = start_game(deck, path, playerCount, argv);
-    fclose(pathFile);
-    fclose(deckFile);
-    free(deck); // path free'd in control_game() (called by start_game())
-    free(childrenIDs); // If SIGHUP is not received, free
-    return dealer_error_message(gameError);
+    return DEALER_NORMAL;
 }
 
 CardType get_card_type(char card) {
@@ -135,180 +226,727 @@ DealerExitCodes validate_deck(char** deckFromFile, size_t* deckLength,
 }
 
 DealerExitCodes start_game(char* deck, char* path, int playerCount,
-	char** argv) {
-    // Initialise dynamic arrays to store the read and write pipes
-    FILE** readPipes = (FILE**)malloc(playerCount * sizeof(FILE*));
-    FILE** writePipes = (FILE**)malloc(playerCount * sizeof(FILE*));
+	char** argv, GameLog* log, char* resumeState) {
+    // Initialise dynamic arrays to store the pipes, and the plugin players.
+    // Plugin players have no pipes, and process players have no plugin.
+    PlayerPipes** pipes = (PlayerPipes**)malloc(playerCount *
+	    sizeof(PlayerPipes*));
+    PluginPlayer** pluginPlayers =
+	    (PluginPlayer**)malloc(playerCount * sizeof(PluginPlayer*));
+    for (int player = 0; player < playerCount; player++) {
+	pipes[player] = NULL;
+	pluginPlayers[player] = NULL;
+	childrenIDs[player] = 0; // No process (yet)
+    }
+    // Players must be able to fall behind by the whole path (and the state
+    // of a resumed game)
+    size_t queueLimit = OUTBOUND_QUEUE_LIMIT + strlen(path) +
+	    (resumeState ? strlen(resumeState) + 1 : 0);
+
     for (int player = 0; player < playerCount; player++) {
+	long long spawnStart = TRACE_START();
+	// exclude first 3 args of dealer argv (dealer program, deck, and path)
+	if (is_plugin_player(argv[player + 3])) {
+	    pluginPlayers[player] = load_plugin_player(argv[player + 3]);
+	    if (!pluginPlayers[player]) {
+		free_and_close_pipes(pipes, playerCount);
+		free_plugin_players(pluginPlayers, playerCount);
+		return DEALER_PLAYER;
+	    }
+	    TRACE_SPAN("load plugin", player, spawnStart,
+		    monotonic_time_ns());
+	    continue;
+	}
 	int toPlayer[2], fromPlayer[2];
     
-	// pipe returns 0 on success - check for failure
-	if (pipe(toPlayer) || pipe(fromPlayer)) {
-	    free_and_close_pipes(readPipes, writePipes, player);
+	// pipe2 returns 0 on success - check for failure. Pipes must not leak
+	// into the other players.
+	if (pipe2(toPlayer, O_CLOEXEC) || pipe2(fromPlayer, O_CLOEXEC)) {
+	    free_and_close_pipes(pipes, playerCount);
+	    free_plugin_players(pluginPlayers, playerCount);
 	    return DEALER_PLAYER;
 	}
-	pid_t processID = fork();
+	// exclude first 3 args of dealer argv (dealer program, deck, and
+	// path). The player must not be reaped before its PID is stored.
+	sigset_t childSignal, previousMask;
+	sigemptyset(&childSignal);
+	sigaddset(&childSignal, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &childSignal, &previousMask);
+	pid_t processID = spawn_player(toPlayer, fromPlayer, argv[player + 3],
+		playerCount, player);
+	if (processID != ERROR_RETURN) {
+	    childrenIDs[player] = processID; // store child PID
+	}
+	sigprocmask(SIG_SETMASK, &previousMask, NULL);
 
-	// check if fork() call failed
-	if (processID < 0) {
-	    free_and_close_pipes(readPipes, writePipes, player);
+	// check if spawning the player failed
+	if (processID == ERROR_RETURN) {
+	    free_and_close_pipes(pipes, playerCount);
+	    free_plugin_players(pluginPlayers, playerCount);
 	    return DEALER_PLAYER;
-	} else if (!processID) {
-	    childrenIDs[player] = getpid(); // store child PID
-	    start_players(toPlayer, fromPlayer, argv, playerCount, player);
 	}
+
 	// Attempt to close(); close() returns a non-zero int on error - check
 	if (close(toPlayer[READ_END]) || close(fromPlayer[WRITE_END])) {
-	    free_and_close_pipes(readPipes, writePipes, player);
+	    free_and_close_pipes(pipes, playerCount);
+	    free_plugin_players(pluginPlayers, playerCount);
 	    return DEALER_PLAYER;
 	}
-	readPipes[player] = fdopen(fromPlayer[READ_END], "r");
-	writePipes[player] = fdopen(toPlayer[WRITE_END], "w");
+	pipes[player] = open_player_pipes(fromPlayer[READ_END],
+		toPlayer[WRITE_END], queueLimit);
+	TRACE_SPAN("spawn", player, spawnStart, monotonic_time_ns());
+    }
 
-	// Check if fdopen failed
-	if (!writePipes[player] || !readPipes[player]) {
-	    // pass in player - 1 to avoid closing after failed fdopen
-	    free_and_close_pipes(readPipes, writePipes, player - 1);
-	    return DEALER_PLAYER;
+    // Successful starting of players should ensure all players return a ^.
+    // Players start up at the same time, so wait for them all at once.
+    if (!receive_handshakes(pipes, playerCount)) {
+	free_and_close_pipes(pipes, playerCount);
+	free_plugin_players(pluginPlayers, playerCount);
+	return DEALER_PLAYER;
+    }
+
+    // Start communication with players and play game
+    DealerExitCodes gameError = control_game(pipes, pluginPlayers,
+	    playerCount, deck, path, log, resumeState);
+    long long teardownStart = TRACE_START();
+    free_and_close_pipes(pipes, playerCount);
+    free_plugin_players(pluginPlayers, playerCount);
+    TRACE_SPAN("teardown", TRACE_DEALER, teardownStart, monotonic_time_ns());
+
+    // Players exit once their pipes are closed, so can now be accounted for
+    if (getenv(LATENCY_REPORT_ENV)) {
+	wait_for_players(REAP_TIMEOUT_MS);
+	report_player_usage(stderr, playerCount);
+    }
+    return gameError;
+}
+
+PlayerPipes* open_player_pipes(int readFd, int writeFd, size_t queueLimit) {
+    PlayerPipes* pipes = (PlayerPipes*)malloc(sizeof(PlayerPipes));
+    pipes->readFd = readFd;
+    pipes->writeFd = writeFd;
+    init_line_buffer(&pipes->inbound, INBOUND_BUFFER_LIMIT);
+    init_outbound_queue(&pipes->outbound, queueLimit);
+
+    // A player that stops reading (or writing) must not hold up the dealer
+    fcntl(readFd, F_SETFL, fcntl(readFd, F_GETFL) | O_NONBLOCK);
+    fcntl(writeFd, F_SETFL, fcntl(writeFd, F_GETFL) | O_NONBLOCK);
+    return pipes;
+}
+
+bool receive_handshakes(PlayerPipes** pipes, int playerCount) {
+    struct pollfd* pollFds = (struct pollfd*)malloc(playerCount *
+	    sizeof(struct pollfd));
+    int* pollPlayers = (int*)malloc(playerCount * sizeof(int));
+    bool* handshakeReceived = (bool*)malloc(playerCount * sizeof(bool));
+    for (int player = 0; player < playerCount; player++) {
+	handshakeReceived[player] = !pipes[player]; // Plugins need none
+    }
+    long long deadline = monotonic_time_ms() + HANDSHAKE_TIMEOUT_MS;
+    long long handshakesStart = TRACE_START();
+    bool handshakesValid = true;
+
+    while (handshakesValid) {
+	int numPollFds = 0;
+	for (int player = 0; player < playerCount; player++) {
+	    if (!handshakeReceived[player]) {
+		pollFds[numPollFds].fd = pipes[player]->readFd;
+		pollFds[numPollFds].events = POLLIN;
+		pollPlayers[numPollFds++] = player;
+	    }
 	}
+	long long timeLeft = deadline - monotonic_time_ms();
+	if (!numPollFds || timeLeft <= 0) {
+	    handshakesValid = !numPollFds; // Some players never started
+	    break;
+	}
+	int numReady = poll(pollFds, numPollFds, timeLeft);
+	for (int i = 0; i < numPollFds && numReady > 0; i++) {
+	    if (!pollFds[i].revents) {
+		continue;
+	    }
+	    PlayerPipes* ready = pipes[pollPlayers[i]];
+	    if (fill_line_buffer(&ready->inbound, ready->readFd) !=
+		    READ_MORE) {
+		close(ready->readFd);
+		ready->readFd = ERROR_RETURN;
+	    }
+	    int handshake = next_char(&ready->inbound);
+	    if (handshake == '^') {
+		handshakeReceived[pollPlayers[i]] = true;
+		TRACE_SPAN("handshake", pollPlayers[i], handshakesStart,
+			monotonic_time_ns());
+	    } else if (handshake != EOF || ready->readFd == ERROR_RETURN) {
+		handshakesValid = false; // Player sent something else/exited
+	    }
+	}
+    }
+    TRACE_SPAN("handshakes", TRACE_DEALER, handshakesStart,
+	    monotonic_time_ns());
+    free(handshakeReceived);
+    free(pollPlayers);
+    free(pollFds);
+    return handshakesValid;
+}
 
-	// Successful starting of players should ensure all players return a ^
-    	if (fgetc(readPipes[player]) != '^') {
-	    free_and_close_pipes(readPipes, writePipes, player);
-	    return DEALER_PLAYER;
+long long monotonic_time_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+bool receive_line(PlayerPipes** pipes, int playerCount, int player,
+	char** line) {
+    while (!next_line(&pipes[player]->inbound, line)) {
+	if (!wait_for_player(pipes, playerCount, player)) {
+	    return false;
 	}
     }
+    return true;
+}
 
-    // Start communication with players and play game
-    DealerExitCodes gameError = control_game(&readPipes, &writePipes,
-	    playerCount, deck, path);
-    free_and_close_pipes(readPipes, writePipes, playerCount);
-    return gameError;
+bool send_to_player(PlayerPipes* pipes, const char* message,
+	size_t messageLength) {
+    // A player that has gone is found out when it is next asked to move, so
+    // only a player that has fallen too far behind is an error here
+    return queue_message(&pipes->outbound, pipes->writeFd, message,
+	    messageLength) != WRITE_OVERFLOW;
 }
 
-void start_players(int toPlayer[2], int fromPlayer[2], char** argv,
+bool wait_for_player(PlayerPipes** pipes, int playerCount, int player) {
+    PlayerPipes* waitingOn = pipes[player];
+    size_t numUnread = waitingOn->inbound.length - waitingOn->inbound.start;
+    while (waitingOn->readFd != ERROR_RETURN &&
+	    waitingOn->inbound.length - waitingOn->inbound.start ==
+	    numUnread) {
+	if (!poll_players(pipes, playerCount, player, -1)) {
+	    return false;
+	}
+    }
+    // Once the player closes its pipe, data can only arrive once more
+    return waitingOn->inbound.length - waitingOn->inbound.start != numUnread;
+}
+
+bool poll_players(PlayerPipes** pipes, int playerCount, int readingPlayer,
+	int timeout) {
+    // At most one pipe per player, plus the pipe being read from. This is
+    // called for every move, hence the arrays are kept on the stack.
+    struct pollfd pollFds[playerCount + 1];
+    int pollPlayers[playerCount + 1];
+    int numPollFds = 0;
+    if (readingPlayer != INVALID_PLAYER_ID) {
+	pollFds[numPollFds].fd = pipes[readingPlayer]->readFd;
+	pollFds[numPollFds].events = POLLIN;
+	pollPlayers[numPollFds++] = readingPlayer;
+    }
+    for (int player = 0; player < playerCount; player++) {
+	if (pipes[player] && outbound_pending(&pipes[player]->outbound)) {
+	    pollFds[numPollFds].fd = pipes[player]->writeFd;
+	    pollFds[numPollFds].events = POLLOUT;
+	    pollPlayers[numPollFds++] = player;
+	}
+    }
+
+    int numReady;
+    while ((numReady = poll(pollFds, numPollFds, timeout)) == ERROR_RETURN &&
+	    errno == EINTR) {
+	// Interrupted before anything was ready (e.g. by SIGUSR1, which is
+	// handled while waiting on a slow player), try again
+	report_requested_latency();
+    }
+    for (int i = 0; i < numPollFds && numReady > 0; i++) {
+	if (!pollFds[i].revents) {
+	    continue;
+	}
+	PlayerPipes* ready = pipes[pollPlayers[i]];
+	if (pollFds[i].events == POLLOUT) {
+	    flush_outbound_queue(&ready->outbound, ready->writeFd);
+	    continue;
+	}
+	ReadStatus readStatus = fill_line_buffer(&ready->inbound,
+		ready->readFd);
+	if (readStatus == READ_OVERFLOW) {
+	    // The player has sent far more than was asked for, so disregard
+	    // all of it
+	    ready->inbound.start = ready->inbound.length;
+	}
+	if (readStatus != READ_MORE) {
+	    // Anything already received from the player may still be used
+	    close(ready->readFd);
+	    ready->readFd = ERROR_RETURN;
+	}
+    }
+    return numReady > 0;
+}
+
+void flush_players(PlayerPipes** pipes, int playerCount) {
+    bool pending = true;
+    while (pending) {
+	pending = false;
+	for (int player = 0; player < playerCount; player++) {
+	    if (pipes[player] && outbound_pending(&pipes[player]->outbound)) {
+		pending = true;
+	    }
+	}
+	// Give up on players that stop reading altogether
+	if (pending && !poll_players(pipes, playerCount, INVALID_PLAYER_ID,
+		DRAIN_TIMEOUT_MS)) {
+	    return;
+	}
+    }
+}
+
+pid_t spawn_player(int toPlayer[2], int fromPlayer[2], char* playerProgram,
 	int playerCount, int player) {
-    // close returns 0 on success - check for failure
-    if (close(toPlayer[WRITE_END]) || close(fromPlayer[READ_END])) {
-	exit(DEALER_PLAYER);
-    }
-
-    // Four arguments must be passed into the execvp() call: The player
-    // program to start, its command line arguments (player count and ID), and
-    // NULL.
-    char** playerArgs = (char**)malloc(4 * sizeof(char*));
-    for (int i = 0; i < 4; i++) {
-	playerArgs[i] = (char*)malloc(INITIAL_BUFFER_SIZE *
-		sizeof(char));
-    }
-    // exclude first 3 args of dealer argv (dealer program, deck, and path)
-    playerArgs[0] = argv[player + 3];
-    sprintf(playerArgs[1], "%d", playerCount);
-    sprintf(playerArgs[2], "%d", player);
-    playerArgs[3] = NULL;
-
-    // suppress player's stderr by re-directing to /dev/null
-    int devNull = open("/dev/null", O_WRONLY);
-    
-    // Check if dup2() failed and attempt to close() - check if close() failed
-    // as well.
-    if (dup2(toPlayer[READ_END], READ_END) == ERROR_RETURN ||
-	    dup2(fromPlayer[WRITE_END], WRITE_END) ==
-	    ERROR_RETURN || dup2(devNull, ERROR_END) == ERROR_RETURN) {
-	if (close(toPlayer[READ_END]) ||
-		close(fromPlayer[WRITE_END]) || close(devNull)) {
-	    exit(DEALER_PLAYER);
+    // Fork the player from a warm zygote if asked to. Programs that cannot
+    // act as zygotes are started afresh.
+    if (getenv(ZYGOTE_PLAYER_ENV)) {
+	pid_t processID = fork_player(toPlayer, fromPlayer, playerProgram,
+		playerCount, player);
+	if (processID != ERROR_RETURN) {
+	    return processID;
 	}
-	exit(DEALER_PLAYER);
     }
-    if (close(toPlayer[READ_END]) ||
-	    close(fromPlayer[WRITE_END]) || close(devNull)) {
-	exit(DEALER_PLAYER);
+    // Four arguments must be passed to the player program: The program
+    // itself, its command line arguments (player count and ID), and NULL.
+    char playerCountArg[INITIAL_BUFFER_SIZE];
+    char playerIDArg[INITIAL_BUFFER_SIZE];
+    sprintf(playerCountArg, "%d", playerCount);
+    sprintf(playerIDArg, "%d", player);
+    char* playerArgs[] = {playerProgram, playerCountArg, playerIDArg, NULL};
+
+    // Connect the pipes to the player's stdin and stdout, and suppress the
+    // player's stderr by re-directing to /dev/null. Every other file
+    // descriptor is closed on exec.
+    posix_spawn_file_actions_t fileActions;
+    if (posix_spawn_file_actions_init(&fileActions)) {
+	return ERROR_RETURN;
+    }
+    // SIGCHLD is blocked while the dealer stores the player's PID, which
+    // the player must not inherit
+    posix_spawnattr_t spawnAttributes;
+    sigset_t noSignals;
+    sigemptyset(&noSignals);
+    posix_spawnattr_init(&spawnAttributes);
+    posix_spawnattr_setsigmask(&spawnAttributes, &noSignals);
+    posix_spawnattr_setflags(&spawnAttributes, POSIX_SPAWN_SETSIGMASK);
+    posix_spawn_file_actions_adddup2(&fileActions, toPlayer[READ_END],
+	    READ_END);
+    posix_spawn_file_actions_adddup2(&fileActions, fromPlayer[WRITE_END],
+	    WRITE_END);
+    posix_spawn_file_actions_addopen(&fileActions, ERROR_END, "/dev/null",
+	    O_WRONLY, 0);
+
+    // Unlike fork(), the dealer's memory is not copied. posix_spawnp also
+    // reports if the player program could not be run.
+    pid_t processID;
+    int spawnError = posix_spawnp(&processID, playerProgram, &fileActions,
+	    &spawnAttributes, playerArgs, environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&spawnAttributes);
+    return spawnError ? ERROR_RETURN : processID;
+}
+
+pid_t fork_player(int toPlayer[2], int fromPlayer[2], char* playerProgram,
+	int playerCount, int player) {
+    Zygote* zygote = zygotes;
+    while (zygote && strcmp(zygote->program, playerProgram)) {
+	zygote = zygote->next;
+    }
+    if (!zygote) {
+	zygote = start_zygote(playerProgram);
+    }
+    if (zygote->controlFd == ERROR_RETURN) {
+	return ERROR_RETURN;
+    }
+    // Send the player's arguments, and the ends of the pipes it will use as
+    // its stdin and stdout
+    char request[INITIAL_BUFFER_SIZE];
+    int requestLength = snprintf(request, INITIAL_BUFFER_SIZE, "%d,%d",
+	    playerCount, player);
+    int gamePipes[2] = {toPlayer[READ_END], fromPlayer[WRITE_END]};
+    char control[CMSG_SPACE(sizeof(gamePipes))];
+    memset(control, 0, sizeof(control));
+    struct iovec requestData = {.iov_base = request,
+	    .iov_len = requestLength};
+    struct msghdr requestMessage = {.msg_iov = &requestData, .msg_iovlen = 1,
+	    .msg_control = control, .msg_controllen = sizeof(control)};
+    struct cmsghdr* pipesMessage = CMSG_FIRSTHDR(&requestMessage);
+    pipesMessage->cmsg_level = SOL_SOCKET;
+    pipesMessage->cmsg_type = SCM_RIGHTS;
+    pipesMessage->cmsg_len = CMSG_LEN(sizeof(gamePipes));
+    memcpy(CMSG_DATA(pipesMessage), gamePipes, sizeof(gamePipes));
+
+    // The zygote replies with the PID of the forked player. A zygote that
+    // does not reply (e.g. a program that is not a zygote at all) is not
+    // used again.
+    struct pollfd reply = {.fd = zygote->controlFd, .events = POLLIN};
+    char processIDReply[INITIAL_BUFFER_SIZE];
+    ssize_t replyLength = ERROR_RETURN;
+    int numReady = 0;
+    if (sendmsg(zygote->controlFd, &requestMessage, MSG_NOSIGNAL) ==
+	    requestLength) {
+	// A signal (e.g. SIGCHLD from another player) does not mean the
+	// zygote has failed
+	while ((numReady = poll(&reply, 1, ZYGOTE_TIMEOUT_MS)) ==
+		ERROR_RETURN && errno == EINTR) {
+	}
+    }
+    if (numReady > 0) {
+	replyLength = recv(zygote->controlFd, processIDReply,
+		INITIAL_BUFFER_SIZE - 1, 0);
+    }
+    pid_t processID = ERROR_RETURN;
+    if (replyLength > 0) {
+	processIDReply[replyLength] = '\0';
+	processID = strtol(processIDReply, NULL, 10);
     }
-    execvp(playerArgs[0], playerArgs);
-    exit(DEALER_PLAYER); // In the case that execvp fails
+    if (processID <= 0) {
+	close(zygote->controlFd);
+	zygote->controlFd = ERROR_RETURN;
+	kill(zygote->processID, SIGKILL);
+	waitpid(zygote->processID, NULL, 0);
+	zygote->processID = ERROR_RETURN;
+	return ERROR_RETURN;
+    }
+    return processID;
+}
+
+Zygote* start_zygote(char* playerProgram) {
+    Zygote* zygote = (Zygote*)malloc(sizeof(Zygote));
+    zygote->program = strdup(playerProgram);
+    zygote->processID = ERROR_RETURN;
+    zygote->controlFd = ERROR_RETURN;
+    zygote->next = zygotes;
+    zygotes = zygote;
+
+    // Packets keep each fork request separate. The socket must not leak
+    // into players or other zygotes.
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, control)) {
+	return zygote;
+    }
+    posix_spawn_file_actions_t fileActions;
+    if (posix_spawn_file_actions_init(&fileActions)) {
+	close(control[0]);
+	close(control[1]);
+	return zygote;
+    }
+    posix_spawn_file_actions_adddup2(&fileActions, control[1], READ_END);
+    posix_spawn_file_actions_adddup2(&fileActions, control[1], WRITE_END);
+    posix_spawn_file_actions_addopen(&fileActions, ERROR_END, "/dev/null",
+	    O_WRONLY, 0);
+    char* zygoteArgs[] = {playerProgram, ZYGOTE_MODE_ARG, NULL};
+    pid_t processID;
+    int spawnError = posix_spawnp(&processID, playerProgram, &fileActions,
+	    NULL, zygoteArgs, environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    close(control[1]);
+    if (spawnError) {
+	close(control[0]);
+	return zygote;
+    }
+    zygote->processID = processID;
+    zygote->controlFd = control[0];
+    return zygote;
 }
 
-DealerExitCodes control_game(FILE*** readPipes, FILE*** writePipes,
-	int playerCount, char* deck, char* path) {
+void close_zygotes(void) {
+    while (zygotes) {
+	Zygote* zygote = zygotes;
+	zygotes = zygote->next;
+	if (zygote->controlFd != ERROR_RETURN) {
+	    close(zygote->controlFd);
+	}
+	// The zygote exits once its control socket is closed
+	if (zygote->processID > 0) {
+	    waitpid(zygote->processID, NULL, 0);
+	}
+	free(zygote->program);
+	free(zygote);
+    }
+}
+
+bool is_plugin_player(char* playerProgram) {
+    size_t programLength = strlen(playerProgram);
+    size_t extensionLength = strlen(STRATEGY_PLUGIN_EXTENSION);
+    return programLength > extensionLength &&
+	    !strcmp(playerProgram + programLength - extensionLength,
+	    STRATEGY_PLUGIN_EXTENSION);
+}
+
+PluginPlayer* load_plugin_player(char* pluginFile) {
+    // Resolve all symbols now, so that a broken plugin fails to start rather
+    // than failing part way through a game
+    void* handle = dlopen(pluginFile, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+	return NULL;
+    }
+    const StrategyPlugin* plugin =
+	    (const StrategyPlugin*)dlsym(handle, STRATEGY_PLUGIN_SYMBOL);
+
+    // Reject plugins built against a different interface version
+    if (!plugin || plugin->abiVersion != STRATEGY_PLUGIN_ABI_VERSION ||
+	    !plugin->moveStrategy) {
+	dlclose(handle);
+	return NULL;
+    }
+    PluginPlayer* pluginPlayer = (PluginPlayer*)malloc(sizeof(PluginPlayer));
+    pluginPlayer->handle = handle;
+    pluginPlayer->plugin = plugin;
+    pluginPlayer->game = NULL;
+    pluginPlayer->path = NULL;
+    return pluginPlayer;
+}
+
+bool start_plugin_player(PluginPlayer* pluginPlayer, char* path,
+	int playerCount, int playerID, char* state) {
+    // The plugin player gets its own game representation, so that it cannot
+    // interfere with the dealer's. Nobody sees its display.
+    pluginPlayer->path = strdup(path);
+    pluginPlayer->game = init_game(pluginPlayer->path, playerCount);
+    pluginPlayer->game->displayEnabled = false;
+    // Plugins share the dealer's process, so are told the mode directly
+    setup_trusted_mode(pluginPlayer->game, getenv(TRUSTED_DEALER_ENV));
+    // A resumed game is brought up to date before the plugin sees it
+    if (state) {
+	apply_state_message(pluginPlayer->game, state);
+    }
+
+    if (pluginPlayer->plugin->init) {
+	return pluginPlayer->plugin->init(pluginPlayer->game,
+		pluginPlayer->game->players[playerID]);
+    }
+    return true;
+}
+
+void free_plugin_players(PluginPlayer** pluginPlayers, int playerCount) {
+    for (int player = 0; player < playerCount; player++) {
+	PluginPlayer* pluginPlayer = pluginPlayers[player];
+	if (!pluginPlayer) {
+	    continue; // Player is a process
+	}
+	// Only tear down plugins that have been started
+	if (pluginPlayer->game) {
+	    if (pluginPlayer->plugin->teardown) {
+		pluginPlayer->plugin->teardown(pluginPlayer->game,
+			pluginPlayer->game->players[player]);
+	    }
+	    free_game(pluginPlayer->game, pluginPlayer->path);
+	}
+	dlclose(pluginPlayer->handle);
+	free(pluginPlayer);
+    }
+    free(pluginPlayers);
+}
+
+DealerExitCodes control_game(PlayerPipes** pipes,
+	PluginPlayer** pluginPlayers, int playerCount, char* deck,
+	char* path, GameLog* log, char* resumeState) {
     Game* game = init_game(path, playerCount);
+    setup_trusted_mode(game, getenv(TRUSTED_DEALER_ENV));
+    if (resumeState) {
+	apply_state_message(game, resumeState); // Validated when loaded
+    }
     // Used to differentiate who called a function that both the dealer and
     // player can call
     bool playerCalled = false;
 
-    // send path to all players
+    // send path to all players, followed by the announcement of trusted
+    // mode and the state of a resumed game
+    long long pathStart = TRACE_START();
+    size_t pathLength = strlen(path);
+    size_t stateLength = resumeState ? strlen(resumeState) + 1 : 0;
+    char* pathMessage = (char*)malloc((pathLength + stateLength +
+	    INITIAL_BUFFER_SIZE) * sizeof(char));
+    int messageLength = sprintf(pathMessage, "%s\n", path);
+    if (game->trustedDealer) {
+	messageLength += sprintf(pathMessage + messageLength, "TRUST%d\n",
+		game->checksumPeriod);
+    }
+    if (resumeState) {
+	messageLength += sprintf(pathMessage + messageLength, "%s\n",
+		resumeState);
+    }
+    for (int player = 0; player < playerCount; player++) {
+	if (pipes[player] && !send_to_player(pipes[player], pathMessage,
+		messageLength)) {
+	    free(pathMessage);
+	    handle_early_game_over(pipes, game, path);
+	    return DEALER_COMMUNICATION;
+	}
+    }
+    free(pathMessage);
+
+    // Plugin players are given the path (and state) directly
     for (int player = 0; player < playerCount; player++) {
-	fprintf((*writePipes)[player], "%s\n", path);
-	fflush((*writePipes)[player]);
+	if (pluginPlayers[player] && !start_plugin_player(
+		pluginPlayers[player], path, playerCount, player,
+		resumeState)) {
+	    handle_early_game_over(pipes, game, path);
+	    return DEALER_COMMUNICATION;
+	}
     }
+    TRACE_SPAN("path broadcast", TRACE_DEALER, pathStart,
+	    monotonic_time_ns());
     
-    // Start and play game
+    // Start and play game. YT is sent along with the previous HAP where
+    // possible, so track whether the player whose turn it is has been asked
+    // to move yet.
+    ALLOC_PHASE(ALLOC_DISPLAY);
     display_game(game, playerCalled);
-    while (!is_game_over(game)) {
-	DealerExitCodes messageError = send_and_receive_messages(game, deck,
-		path, readPipes, writePipes, playerCalled);
-	if (messageError != DEALER_NORMAL) {
-	    return messageError;
-	}
+    ALLOC_PHASE(ALLOC_TURN);
+    bool moverAsked = false;
+    gameLatency = init_latency_stats(playerCount);
+    DealerExitCodes messageError = DEALER_NORMAL;
+    while (messageError == DEALER_NORMAL && !is_game_over(game)) {
+	messageError = send_and_receive_messages(game, deck, path, pipes,
+		pluginPlayers, &moverAsked, gameLatency, log, playerCalled);
+	report_requested_latency();
+	checkpoint_game(game, false);
+    }
+    ALLOC_PHASE(ALLOC_TEARDOWN);
+    if (getenv(LATENCY_REPORT_ENV)) {
+	report_latency_stats(stderr, gameLatency);
+    }
+    free_latency_stats(gameLatency);
+    gameLatency = NULL;
+    if (messageError != DEALER_NORMAL) {
+	return messageError;
     }
 
     // Notify players of normal game over. Clean up, show scores and finish.
     for (int player = 0; player < playerCount; player++) {
-	fprintf((*writePipes)[player], "DONE\n");
-	fflush((*writePipes)[player]);
+	if (!pipes[player]) {
+	    continue; // Plugins are torn down once the game is freed
+	}
+	send_to_player(pipes[player], "DONE\n", strlen("DONE\n"));
     }
+    flush_players(pipes, playerCount);
+    long long scoringStart = TRACE_START();
     calculate_final_scores(game, playerCalled);
+    TRACE_SPAN("final scores", TRACE_DEALER, scoringStart,
+	    monotonic_time_ns());
+    if (!finish_game_log(log, game, DEALER_NORMAL)) {
+	fprintf(stderr, "Unable to write game log to %s\n",
+		getenv(GAME_LOG_ENV));
+    }
     free_game(game, path);
     return DEALER_NORMAL;
 }
 
 DealerExitCodes send_and_receive_messages(Game* game, char* deck, char* path,
-	FILE*** readPipes, FILE*** writePipes, bool playerCalled) {
-    // Form string to store DO messages
-    size_t doLength = INITIAL_BUFFER_SIZE;
-    char* getDo = (char*)malloc(doLength * sizeof(char));
+	PlayerPipes** pipes, PluginPlayer** pluginPlayers, bool* moverAsked,
+	LatencyStats* stats, GameLog* log, bool playerCalled) {
+    // Store DO messages. Messages from player processes are read in place.
+    char pluginDo[INITIAL_BUFFER_SIZE];
+    char* getDo = pluginDo;
     
     int whoseTurn = calculate_whose_turn(game);
-    
-    // Ask the player whose turn it is to send back a move
-    fprintf((*writePipes)[whoseTurn], "YT\n");
-    fflush((*writePipes)[whoseTurn]);
-    
-    // Attempt to read the player message, check for EOF
-    if (get_line(&getDo, &doLength, (*readPipes)[whoseTurn]),
-	    strlen(getDo) != 0) {
-	// Ensure message received is a valid DO message
-	if (get_message_type(game, game->players[whoseTurn], getDo) ==
-		MESSAGE_DO) {
-	    // First 2 chars are the letters DO, extract the site number.
-	    // Message has been validated so error buffer can be NULL.
-	    int siteToMoveTo = strtol(getDo + 2, NULL, 10);
-
-	    // Form the required HAP message and send to all players
-	    char* hapMessage = create_hap_message(game, whoseTurn,
-		    siteToMoveTo, deck);
-	    for (int player = 0; player < game->playerCount; player++) {
-		fprintf((*writePipes)[player], "%s\n", hapMessage);
-		fflush((*writePipes)[player]);
-	    }
+    PluginPlayer* pluginPlayer = pluginPlayers[whoseTurn];
 
-	    // Update game details and re-display game and player details
-	    process_hap_details(game, hapMessage, playerCalled);
-	    free(hapMessage);
-	    display_game(game, playerCalled);
-	} else {
-	    // Dealer should only receive (valid) DO messages
-	    free(getDo);
-	    handle_early_game_over(writePipes, game, path);
+    if (pluginPlayer) {
+	// Ask the plugin for its move directly, and form the DO message that
+	// a player process would have sent, so that it is validated the same
+	// way
+	stats->askedAt[whoseTurn] = monotonic_time_ns();
+	int pluginMove = pluginPlayer->plugin->moveStrategy(
+		pluginPlayer->game, pluginPlayer->game->players[whoseTurn]);
+	snprintf(pluginDo, INITIAL_BUFFER_SIZE, "DO%d", pluginMove);
+    } else {
+	// Ask the player whose turn it is to send back a move, unless this
+	// was done along with the last HAP message. Handle communication
+	// errors (e.g. unexpected EOF on stdin).
+	if (!*moverAsked) {
+	    stats->askedAt[whoseTurn] = monotonic_time_ns();
+	}
+	if ((!*moverAsked && !send_to_player(pipes[whoseTurn], "YT\n",
+		strlen("YT\n"))) || !receive_line(pipes, game->playerCount,
+		whoseTurn, &getDo)) {
+	    handle_early_game_over(pipes, game, path);
 	    return DEALER_COMMUNICATION;
 	}
-    } else {
-	// Handle other communication errors (e.g. unexpected EOF on stdin)
-	free(getDo);
-	handle_early_game_over(writePipes, game, path);
+	*moverAsked = false;
+    }
+    long long moveReceived = monotonic_time_ns();
+    long long moveLatency = moveReceived - stats->askedAt[whoseTurn];
+    record_latency(&stats->players[whoseTurn], moveLatency);
+    record_latency(&stats->allPlayers, moveLatency);
+    TRACE_SPAN("move", whoseTurn, stats->askedAt[whoseTurn], moveReceived);
+    
+    // Ensure message received is a valid DO message
+    HapDetails move;
+    if (decode_message(game, game->players[whoseTurn], getDo, &move) !=
+	    MESSAGE_DO) {
+	// Dealer should only receive (valid) DO messages
+	handle_early_game_over(pipes, game, path);
 	return DEALER_COMMUNICATION;
     }
-    free(getDo);
+    long long moveValidated = monotonic_time_ns();
+    record_latency(&stats->phases[PHASE_VALIDATE],
+	    moveValidated - moveReceived);
+    TRACE_SPAN("validate", TRACE_DEALER, moveReceived, moveValidated);
+
+    // Form the required HAP message and update game details, so that the
+    // next player to move is known before the HAP is sent
+    char messages[TURN_MESSAGES_SIZE];
+    int messagesLength = create_hap_message(game, &move, deck, messages);
+    log_game_move(log, &move);
+    process_hap_details(game, &move, playerCalled);
+    int nextMover = is_game_over(game) ? INVALID_PLAYER_ID :
+	    calculate_whose_turn(game);
+
+    // Every player is sent the HAP, followed by a SUM if due (to let
+    // trusting players check that their game state matches). The next player
+    // to move is also sent YT in the same write.
+    if (checksum_due(game)) {
+	messagesLength += sprintf(messages + messagesLength, "SUM%u\n",
+		calculate_game_checksum(game));
+    }
+    int ytLength = sprintf(messages + messagesLength, "YT\n");
+    long long hapFormed = monotonic_time_ns();
+    record_latency(&stats->phases[PHASE_HAP], hapFormed - moveValidated);
+    TRACE_SPAN("hap", TRACE_DEALER, moveValidated, hapFormed);
+    bool sendError = false;
+    for (int player = 0; player < game->playerCount; player++) {
+	if (pluginPlayers[player]) {
+	    // Keep the plugin player's game up to date
+	    process_hap_details(pluginPlayers[player]->game, &move,
+		    !playerCalled);
+	    continue;
+	}
+	if (!send_to_player(pipes[player], messages, messagesLength +
+		(player == nextMover ? ytLength : 0))) {
+	    sendError = true;
+	}
+    }
+    *moverAsked = nextMover != INVALID_PLAYER_ID &&
+	    !pluginPlayers[nextMover];
+
+    long long hapSent = monotonic_time_ns();
+    record_latency(&stats->phases[PHASE_BROADCAST], hapSent - hapFormed);
+    TRACE_SPAN("hap broadcast", TRACE_DEALER, hapFormed, hapSent);
+
+    // A player that has fallen too far behind cannot keep playing
+    if (sendError) {
+	handle_early_game_over(pipes, game, path);
+	return DEALER_COMMUNICATION;
+    }
+
+    // Re-display game and player details
+    ALLOC_PHASE(ALLOC_DISPLAY);
+    display_game(game, playerCalled);
+    ALLOC_PHASE(ALLOC_TURN);
+    long long moveFinished = monotonic_time_ns();
+    record_latency(&stats->phases[PHASE_DISPLAY], moveFinished - hapSent);
+    TRACE_SPAN("display", TRACE_DEALER, hapSent, moveFinished);
+    record_latency(&stats->dealer, moveFinished - moveReceived);
+
+    // The next player's YT has been sent, but their time is only counted
+    // from when the dealer is done with this move
+    if (nextMover != INVALID_PLAYER_ID) {
+	stats->askedAt[nextMover] = moveFinished;
+    }
     return DEALER_NORMAL;
 }
 
@@ -331,6 +969,14 @@ void setup_signal_handling(int playerCount) {
     sigpipeHandlingSetup.sa_flags = SA_RESTART;
     sigaction(SIGPIPE, &sigpipeHandlingSetup, NULL);
 
+    // Report the latencies of the game in progress on SIGUSR1, rather than
+    // being terminated
+    struct sigaction sigusr1HandlingSetup;
+    memset(&sigusr1HandlingSetup, 0, sizeof(struct sigaction));
+    sigusr1HandlingSetup.sa_handler = request_latency_report;
+    sigusr1HandlingSetup.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sigusr1HandlingSetup, NULL);
+
     // Setup array to store child PIDs. Require numChildren global as
     // playerCount is required by several functions.
     numChildren = playerCount;
@@ -339,57 +985,112 @@ void setup_signal_handling(int playerCount) {
 
 void kill_and_reap_children(int signal) {
     for (int child = 0; child < numChildren; child++) {
+	// Plugin players (and players yet to be started) have no process. The
+	// PID is copied, as reap_players() clears it once the player exits.
+	pid_t childID = childrenIDs[child];
+	if (childID <= 0) {
+	    continue;
+	}
 	// SIGKILL cannot be handled. Ensures that any player program run by
 	// the dealer is killed and reaped (i.e. removes the concern of player
 	// programs having handlers that prevent them from being killed)
-	kill(childrenIDs[child], SIGKILL);
-	waitpid(childrenIDs[child], NULL, 0);
+	kill(childID, SIGKILL);
+	waitpid(childID, NULL, 0);
     }
     exit(DEALER_COMMUNICATION);
 }
 
-int calculate_whose_turn(Game* game) {
-    // Turn belongs to player furthest back. Iterate from first site onwards
-    for (int site = 0; site < game->path->numSites; site++) {
-	// Turn belongs to player at bottom of aforementioned site. Iterate
-	// from bottom of site upwards
-	for (int player = game->playerCount - 1; player >= 0; player--) {
-	    // Parts of the site unoccupied have value INVALID_PLAYER_ID. Look
-	    // for first part of site which has a player (i.e. bottom player)
-	    if (game->path->sites[site].playersAtSite[player] !=
-		    INVALID_PLAYER_ID) {
-		return game->path->sites[site].playersAtSite[player];
+void setup_child_reaping(int playerCount) {
+    childrenUsage = (struct rusage*)calloc(playerCount,
+	    sizeof(struct rusage));
+    childrenReaped = (volatile sig_atomic_t*)calloc(playerCount,
+	    sizeof(sig_atomic_t));
+
+    // Players are reaped as soon as they exit, rather than when the dealer
+    // exits
+    struct sigaction sigchldHandlingSetup;
+    memset(&sigchldHandlingSetup, 0, sizeof(struct sigaction));
+    sigchldHandlingSetup.sa_handler = reap_players;
+    sigchldHandlingSetup.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sigchldHandlingSetup, NULL);
+}
+
+void reap_players(int signal) {
+    // Only async-signal-safe functions are used, and errno is left as the
+    // interrupted code had it
+    int savedErrno = errno;
+    struct rusage usage;
+    pid_t childID;
+    while ((childID = wait4(-1, NULL, WNOHANG, &usage)) > 0) {
+	for (int child = 0; child < numChildren; child++) {
+	    if (childrenIDs[child] == childID) {
+		childrenUsage[child] = usage;
+		childrenReaped[child] = 1;
+		childrenIDs[child] = 0; // Must not be killed on SIGHUP
+		break;
 	    }
 	}
     }
-    return INVALID_PLAYER_ID; // Something went wrong, should never reach here
+    errno = savedErrno;
 }
 
-bool is_game_over(Game* game) {
-    // The game is over when all players are on the last site. Count how many
-    // players are *not* on the last site. If this is 0, the game is over.
-    int numAvailableSpacesOnLastSite = 0;
-    for (int player = 0; player < game->playerCount; player++) {
-	int finalSite = game->path->numSites - 1;
-	if (game->path->sites[finalSite].playersAtSite[player] ==
-		INVALID_PLAYER_ID) {
-	    numAvailableSpacesOnLastSite++;
+void wait_for_players(int timeout) {
+    // SIGCHLD is only let through while waiting, so that a player exiting
+    // between checking and waiting is not missed
+    sigset_t childSignal, previousMask;
+    sigemptyset(&childSignal);
+    sigaddset(&childSignal, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &childSignal, &previousMask);
+    long long deadline = monotonic_time_ms() + timeout;
+    while (true) {
+	bool waiting = false;
+	for (int child = 0; child < numChildren && !waiting; child++) {
+	    // Players forked from a zygote cannot be waited on by the dealer
+	    siginfo_t childInfo;
+	    waiting = childrenIDs[child] > 0 && !waitid(P_PID,
+		    childrenIDs[child], &childInfo,
+		    WEXITED | WNOHANG | WNOWAIT);
 	}
+	long long timeLeft = deadline - monotonic_time_ms();
+	if (!waiting || timeLeft <= 0) {
+	    break;
+	}
+	struct timespec waitTime = {.tv_sec = timeLeft / 1000,
+		.tv_nsec = (timeLeft % 1000) * 1000000};
+	ppoll(NULL, 0, &waitTime, &previousMask);
+    }
+    sigprocmask(SIG_SETMASK, &previousMask, NULL);
+}
+
+void report_player_usage(FILE* output, int playerCount) {
+    char label[LATENCY_LABEL_SIZE];
+    for (int player = 0; player < playerCount; player++) {
+	snprintf(label, LATENCY_LABEL_SIZE, "Player %d", player);
+	// Plugins, players forked from a zygote, and players that are yet
+	// to exit cannot be accounted for separately
+	print_usage_summary(output, label,
+		childrenReaped[player] ? &childrenUsage[player] : NULL);
     }
-    // Game is over if numAvailableSpacesOnLastSite == 0
-    return (!numAvailableSpacesOnLastSite);
+    struct rusage dealerUsage;
+    getrusage(RUSAGE_SELF, &dealerUsage);
+    print_usage_summary(output, "Dealer", &dealerUsage);
+    fflush(output);
+}
+
+bool is_game_over(Game* game) {
+    // The game is over when all players are on the last site
+    return count_players_at_site(game->path, game->path->numSites - 1) ==
+	    game->playerCount;
 }
 
-char* create_hap_message(Game* game, int movingPlayer, int newSite,
-	char* deck) {
-    int movingPlayerMoney = game->players[movingPlayer]->money;
-    char* hapMessage = (char*)malloc(INITIAL_BUFFER_SIZE * sizeof(char));
-    char* newSiteType = game->path->sites[newSite].type;
+int create_hap_message(Game* game, HapDetails* move, char* deck,
+	char* hapMessage) {
+    int movingPlayerMoney = game->players[move->playerID]->money;
     int changeInPoints = 0;
     int changeInMoney = 0;
     CardType cardDrawn = CARD_ERROR;
 
-    switch(get_site_type(newSiteType)) {
+    switch(game->path->sites[move->newSite].siteType) {
 	case SITE_MO:
 	    changeInMoney = 3;
 	    break;
@@ -405,9 +1106,12 @@ char* create_hap_message(Game* game, int movingPlayer, int newSite,
 	    // message. Their actions are handled in process_hap_details()
 	    break;
     }
-    sprintf(hapMessage, "HAP%d,%d,%d,%d,%d", movingPlayer, newSite,
-	    changeInPoints, changeInMoney, cardDrawn);
-    return hapMessage;
+    move->additionalPoints = changeInPoints;
+    move->moneyChange = changeInMoney;
+    move->cardDrawn = cardDrawn;
+    return snprintf(hapMessage, HAP_MESSAGE_SIZE, "HAP%d,%d,%d,%d,%d\n",
+	    move->playerID, move->newSite, changeInPoints, changeInMoney,
+	    cardDrawn);
 }
 
 CardType draw_next_card(Game* game, char* deck) {
@@ -435,20 +1139,32 @@ CardType draw_next_card(Game* game, char* deck) {
     return get_card_type(deckWithoutLength[nextCardIndex]);
 }
 
-void handle_early_game_over(FILE*** writePipes, Game* game, char* path) {
+void handle_early_game_over(PlayerPipes** pipes, Game* game, char* path) {
+    checkpoint_game(game, true);
     for (int player = 0; player < game->playerCount; player++) {
-	fprintf((*writePipes)[player], "EARLY\n");
-	fflush((*writePipes)[player]);
+	// Plugin players have no pipes
+	if (!pipes[player]) {
+	    continue;
+	}
+	send_to_player(pipes[player], "EARLY\n", strlen("EARLY\n"));
     }
+    flush_players(pipes, game->playerCount);
     free_game(game, path);
 }
 
-void free_and_close_pipes(FILE** readPipes, FILE** writePipes,
-	int playerCount) {
-    for (int pipe = 0; pipe < playerCount; pipe++) {
-	fclose(writePipes[pipe]);
-	fclose(readPipes[pipe]);
+void free_and_close_pipes(PlayerPipes** pipes, int playerCount) {
+    for (int player = 0; player < playerCount; player++) {
+	// Plugin players have no pipes
+	if (!pipes[player]) {
+	    continue;
+	}
+	if (pipes[player]->readFd != ERROR_RETURN) {
+	    close(pipes[player]->readFd);
+	}
+	close(pipes[player]->writeFd);
+	free_line_buffer(&pipes[player]->inbound);
+	free_outbound_queue(&pipes[player]->outbound);
+	free(pipes[player]);
     }
-    free(writePipes);
-    free(readPipes);
+    free(pipes);
 }
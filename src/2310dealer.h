@@ -12,8 +12,22 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <time.h>
 #include "dealerErrors.h"
 #include "2310X.h"
+#include "2310io.h"
+#include "2310latency.h"
+#include "2310trace.h"
+#include "2310alloc.h"
+#include "2310gamelog.h"
+#include "2310checkpoint.h"
+#include "2310plugin.h"
 
 /* As per the assignment spec, the minimum number of cards allowed in a deck
  * file is 4. */
@@ -31,6 +45,52 @@
 /* Several system calls return -1 on error. Check for this. */
 #define ERROR_RETURN (-1)
 
+/* How long (in milliseconds) players are given to start up and send their
+ * ^, all together (per game, in server mode). */
+#define HANDSHAKE_TIMEOUT_MS 10000
+
+/* Once a game is over, how long (in milliseconds) players that are behind
+ * are waited on to read their remaining messages before giving up. */
+#define DRAIN_TIMEOUT_MS 5000
+
+/* How long (in milliseconds) a zygote is given to reply to a fork request. */
+#define ZYGOTE_TIMEOUT_MS 1000
+
+/* Once the game is over, how long (in milliseconds) player processes are
+ * waited on to exit, so that their resource usage can be reported (only
+ * when the report is requested, see LATENCY_REPORT_ENV). */
+#define REAP_TIMEOUT_MS 1000
+
+/* Number the game is logged as when the dealer is not in server mode (see
+ * GAME_LOG_ENV). */
+#define SINGLE_GAME_NUMBER 1
+
+/* Zygote representation (a player program serving fork requests, see
+ * ZYGOTE_PLAYER_ENV). A zygote that could not be started is kept with no
+ * control socket, so that it is not tried again. */
+typedef struct Zygote {
+    char* program;
+    pid_t processID;
+    int controlFd;
+    struct Zygote* next;
+} Zygote;
+
+/* Global list - Stores the zygote of each player program used so far. */
+extern Zygote* zygotes;
+
+/* Global array - Stores PIDs of child processes (0 if a slot is unused). */
+extern pid_t* childrenIDs;
+
+/* Global variable - stores length of childrenIDs array. */
+extern int numChildren;
+
+/* Global array - Stores the resource usage of each player process, once it
+ * has been reaped (as recorded in childrenReaped). */
+extern struct rusage* childrenUsage;
+
+/* Global array - Stores whether each player process has been reaped. */
+extern volatile sig_atomic_t* childrenReaped;
+
 /* Card Types */
 typedef enum {
     CARD_ERROR = 0,
@@ -41,6 +101,38 @@ typedef enum {
     CARD_E = 5
 } CardType;
 
+/* Pipes to and from a player process. Both are non-blocking, so that one
+ * player cannot hold up the dealer. */
+typedef struct {
+    // Pipe from the player (-1 once the player has closed it), and data
+    // received from the player that has not been processed yet
+    int readFd;
+    LineBuffer inbound;
+
+    // Pipe to the player, and messages waiting until the player catches up
+    int writeFd;
+    OutboundQueue outbound;
+} PlayerPipes;
+
+/* In-process (plugin) player representation */
+typedef struct {
+    // Handle returned by dlopen(), and the strategy the plugin exports
+    void* handle;
+    const StrategyPlugin* plugin;
+
+    // The plugin player's own game representation (NULL until the path has
+    // been sent), along with the copy of the path it was initialised from
+    Game* game;
+    char* path;
+} PluginPlayer;
+
+/* Takes in the names of the deck and path files, as well as empty buffers to
+ * store the (validated) deck and path. Reads and validates both files, and
+ * returns the appropriate dealer exit code. On error, nothing needs to be
+ * freed. */
+DealerExitCodes load_game_files(char* deckFileName, char* pathFileName,
+	char** deck, char** path);
+
 /* Takes in the deck representation of a card and returns the appropriate card
  * type. */
 CardType get_card_type(char card);
@@ -51,69 +143,186 @@ CardType get_card_type(char card);
 DealerExitCodes validate_deck(char** deckFromFile, size_t* deckLength,
 	FILE* deckFile);
 
-/* Takes in the validated deck and path, the number of players, as well as the
- * command-line arguments (to extract the player programs). Entry point for
- * game. Returns the appropriate dealer exit code. */
+/* Takes in the validated deck and path, the number of players, the
+ * command-line arguments (to extract the player programs), the log of the
+ * game (NULL if not logged), as well as the STATE message of the game being
+ * resumed (NULL for a new game, see CHECKPOINT_ENV). Entry point for game.
+ * Returns the appropriate dealer exit code. The log is finished if the game
+ * ends normally. */
 DealerExitCodes start_game(char* deck, char* path, int playerCount,
-	char** argv);
+	char** argv, GameLog* log, char* resumeState);
+
+/* Takes in the file descriptors of the pipes from and to a player process,
+ * and the most bytes that may wait to be sent to said player. Makes both
+ * pipes non-blocking, and returns the player's pipes representation. */
+PlayerPipes* open_player_pipes(int readFd, int writeFd, size_t queueLimit);
+
+/* Takes in the pipes of each player (NULL for plugin players), and the
+ * player count. Waits for every player process to send its ^, for at most
+ * HANDSHAKE_TIMEOUT_MS overall. Returns if every handshake was received. */
+bool receive_handshakes(PlayerPipes** pipes, int playerCount);
 
-/* Takes in the (piped) file descriptors, the command-line arguments, the
- * player count, and the current player ID. Ensures valid start of player
- * processes. */
-void start_players(int toPlayer[2], int fromPlayer[2], char** argv,
+/* Returns the current time of the monotonic clock in milliseconds. */
+long long monotonic_time_ms(void);
+
+/* Takes in the pipes of each player, the player count, the ID of a player,
+ * and a pointer to store the line in. Waits for said player to send a whole
+ * line (writing queued messages to other players in the meantime), and
+ * returns if one was received. See next_line() for the lifetime of *line. */
+bool receive_line(PlayerPipes** pipes, int playerCount, int player,
+	char** line);
+
+/* Takes in a player's pipes, and a message of the given length. Sends (or
+ * queues) said message, and returns false if the player has fallen too far
+ * behind to queue it. */
+bool send_to_player(PlayerPipes* pipes, const char* message,
+	size_t messageLength);
+
+/* Takes in the pipes of each player, the player count, and the ID of a
+ * player. Waits until more data has been received from said player, writing
+ * queued messages to every player in the meantime. Returns false if said
+ * player has closed its pipe, so no more data will arrive. */
+bool wait_for_player(PlayerPipes** pipes, int playerCount, int player);
+
+/* Takes in the pipes of each player, the player count, the ID of the player
+ * to read from (or INVALID_PLAYER_ID to only write), and the timeout for
+ * poll(). Waits until said player has sent data or queued messages can be
+ * written, and reads or writes them. Returns false if nothing was ready
+ * before the timeout. */
+bool poll_players(PlayerPipes** pipes, int playerCount, int readingPlayer,
+	int timeout);
+
+/* Takes in the pipes of each player, and the player count. Waits for every
+ * queued message to be written, giving up on players that have not read
+ * anything for DRAIN_TIMEOUT_MS. */
+void flush_players(PlayerPipes** pipes, int playerCount);
+
+/* Takes in the (piped, close-on-exec) file descriptors, the player program,
+ * the player count, and the current player ID. Starts the player process
+ * with the pipes as its stdin and stdout. Returns its PID, or -1 if it could
+ * not be started. */
+pid_t spawn_player(int toPlayer[2], int fromPlayer[2], char* playerProgram,
+	int playerCount, int player);
+
+/* Takes in the same arguments as spawn_player(). Forks the player from the
+ * zygote of said player program, starting the zygote if this has not been
+ * tried yet. Returns the player's PID, or -1 if there is no working zygote.
+ * */
+pid_t fork_player(int toPlayer[2], int fromPlayer[2], char* playerProgram,
 	int playerCount, int player);
 
-/* Takes in the collection of read and write pipes to communicate with the
- * players, as well as the number of players, and the (validated) deck and
- * path. Controls main gameplay and communcation between players. Returns the
- * appropriate exit code at the end of the game. */
-DealerExitCodes control_game(FILE*** readPipes, FILE*** writePipes,
-	int playerCount, char* deck, char* path);
+/* Takes in a player program. Starts said program as a zygote, and adds it to
+ * the list of zygotes. Returns the zygote representation. */
+Zygote* start_zygote(char* playerProgram);
+
+/* Closes the control socket of every zygote, letting them exit, and reaps
+ * them. */
+void close_zygotes(void);
+
+/* Takes in a player program from the command-line arguments. Returns if said
+ * program is a strategy plugin to be loaded in-process. */
+bool is_plugin_player(char* playerProgram);
+
+/* Takes in the file name of a strategy plugin. Loads the plugin and checks
+ * that it implements the expected plugin interface version. Returns the
+ * plugin player representation, or NULL if the plugin could not be loaded.
+ * */
+PluginPlayer* load_plugin_player(char* pluginFile);
+
+/* Takes in a plugin player representation, the (validated) path, the player
+ * count, the ID of the plugin player, and the STATE message of a resumed
+ * game (NULL for a new game). Sets up the plugin player's own game
+ * representation, applies said state to it, and initialises the plugin.
+ * Returns if the plugin is ready to play. */
+bool start_plugin_player(PluginPlayer* pluginPlayer, char* path,
+	int playerCount, int playerID, char* state);
+
+/* Takes in the collection of plugin players (NULL for players that are
+ * processes), as well as the player count. Tears down and unloads each plugin
+ * and frees the memory associated to the collection. */
+void free_plugin_players(PluginPlayer** pluginPlayers, int playerCount);
+
+/* Takes in the pipes to communicate with each player, the collection of
+ * plugin players, as well as the number of players, the (validated) deck
+ * and path, the log of the game (NULL if not logged), and the STATE message
+ * of the game being resumed (NULL for a new game). Controls main gameplay
+ * and communcation between players, timing (and logging) each move (see
+ * LATENCY_REPORT_ENV), and checkpointing the game (see CHECKPOINT_ENV).
+ * Returns the appropriate exit code at the end of the game, having finished
+ * the log if the game ended normally. */
+DealerExitCodes control_game(PlayerPipes** pipes,
+	PluginPlayer** pluginPlayers, int playerCount, char* deck,
+	char* path, GameLog* log, char* resumeState);
 
 /* Takes in the game representation, the (validated) deck file contents, the
- * (validated) path file contents, the read and write pipes, and a flag to
- * identify if a player or the dealer called particular functions that both
- * players and the dealer can call. This flag should be passed as false.
- * Communicates with the player via string messages, and processes messages
- * received. Returns the appropriate dealer exit code. */
+ * (validated) path file contents, the pipes of each player, the plugin
+ * players, whether the player whose turn it is has already been sent YT
+ * (updated for the next move), the latencies of the game (which the time
+ * taken by the player and the dealer for this move are added to), the log
+ * of the game (NULL if not logged), and a flag to identify if a player or
+ * the dealer called particular functions
+ * that both players and the dealer can call. This flag should be passed as
+ * false. Communicates with the player via string messages (or, for plugin
+ * players, asks the plugin for its move directly), and processes messages
+ * received. The YT for the next move is sent in the same write as the HAP
+ * message. Returns the appropriate dealer exit code. */
 DealerExitCodes send_and_receive_messages(Game* game, char* deck, char* path,
-	FILE*** readPipes, FILE*** writePipes, bool playerCalled);
+	PlayerPipes** pipes, PluginPlayer** pluginPlayers, bool* moverAsked,
+	LatencyStats* stats, GameLog* log, bool playerCalled);
 
 /* Takes in the player count. Ensure program does not use default signal
- * handlers. */
+ * handlers. SIGUSR1 requests a report of the game's latencies. */
 void setup_signal_handling(int playerCount);
 
 /* Takes in a signal from the kernel (SIGHUP specifically). Updates the global
  * variable flag to identify whether SIGHUP has been received to true. */
 void kill_and_reap_children(int signal);
 
-/* Takes in the game representation and returns the player ID of the player
- * who should move next. */
-int calculate_whose_turn(Game* game);
+/* Takes in the player count. Sets up the reaping of player processes as soon
+ * as they exit, recording their resource usage. Only used when playing a
+ * single game, as childrenIDs must not be resized once set up. */
+void setup_child_reaping(int playerCount);
+
+/* Takes in a signal from the kernel (SIGCHLD specifically). Reaps every
+ * child process that has exited, recording the resource usage of those that
+ * are players. */
+void reap_players(int signal);
+
+/* Takes in a timeout in milliseconds. Waits for every player process that is
+ * a child of the dealer to exit and be reaped, for at most said timeout.
+ * Players forked from a zygote are children of the zygote, so are not
+ * waited on. */
+void wait_for_players(int timeout);
+
+/* Takes in a file and the player count. Prints the CPU time, max RSS and
+ * context switches of each player process that has been reaped, and of the
+ * dealer itself (including any plugin players). */
+void report_player_usage(FILE* output, int playerCount);
 
 /* Takes in the game representation and returns whether the game is over. */
 bool is_game_over(Game* game);
 
-/* Takes in the game representation, the ID of the moving player, the site
- * that they would like to move to, and the deck. Returns the HAP message to
- * send to the player to execute. */
-char* create_hap_message(Game* game, int movingPlayer, int newSite,
-	char* deck);
+/* Takes in the game representation, the (decoded) DO message of the moving
+ * player, i.e. the site that they would like to move to, and the deck.
+ * Completes the rest of the move details, and writes the HAP message (with
+ * its newline) for the players to execute to hapMessage, which must hold
+ * HAP_MESSAGE_SIZE chars. Returns the length of said message. */
+int create_hap_message(Game* game, HapDetails* move, char* deck,
+	char* hapMessage);
 
 /* Takes in the game representation and the (validated) deck in the given file
  * format. Returns the next card to be drawn (in the format required by the
  * HAP message). */
 CardType draw_next_card(Game* game, char* deck);
 
-/* Takes in the write pipes, the game representation, and the path. Handles
- * clean up of early game over. */
-void handle_early_game_over(FILE*** writePipes, Game* game,
-	char* path);
+/* Takes in the pipes of each player, the game representation, and the path.
+ * Handles clean up of early game over, saving the game first so that it can
+ * be resumed (see CHECKPOINT_ENV). */
+void handle_early_game_over(PlayerPipes** pipes, Game* game, char* path);
 
-/* Takes in the read and write pipes, as well as the player count. Closes
- * each pipe and frees the memory associated to the collections of read and
- * write pipes. */
-void free_and_close_pipes(FILE** readPipes, FILE** writePipes,
-	int playerCount);
+/* Takes in the pipes of each player, as well as the player count. Closes
+ * each pipe (plugin players have none) and frees the memory associated to
+ * the collection of pipes. */
+void free_and_close_pipes(PlayerPipes** pipes, int playerCount);
 
 #endif
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "2310gamelog.h"
+#include "2310X.h"
+
+uint64_t hash_text(const char* text) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const unsigned char* next = (const unsigned char*)text; *next;
+	    next++) {
+	hash ^= *next;
+	hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+GameLog* start_game_log(int gameNumber, char* deck, char* path,
+	int playerCount, char** programs) {
+    char* fileName = getenv(GAME_LOG_ENV);
+    if (!fileName) {
+	return NULL;
+    }
+    GameLog* log = (GameLog*)malloc(sizeof(GameLog));
+    log->size = INITIAL_BUFFER_SIZE;
+    log->data = (char*)malloc(log->size * sizeof(char));
+    log->length = 0;
+    log->fileName = fileName;
+    log->numMoves = 0;
+    log->failed = !log->data;
+
+    size_t lineupLength = 0;
+    for (int player = 0; player < playerCount; player++) {
+	lineupLength += strlen(programs[player]) + 1;
+    }
+    GameLogHeader header;
+    memset(&header, 0, sizeof(GameLogHeader));
+    memcpy(header.magic, GAME_LOG_MAGIC, GAME_LOG_MAGIC_SIZE);
+    header.version = GAME_LOG_VERSION;
+    header.gameNumber = gameNumber;
+    header.playerCount = playerCount;
+    header.deckHash = hash_text(deck);
+    header.pathHash = hash_text(path);
+    header.pathLength = strlen(path);
+    header.lineupLength = lineupLength;
+    append_game_log(log, &header, sizeof(GameLogHeader));
+    append_game_log(log, path, header.pathLength);
+    for (int player = 0; player < playerCount; player++) {
+	append_game_log(log, programs[player], strlen(programs[player]) + 1);
+    }
+    return log;
+}
+
+void append_game_log(GameLog* log, const void* data, size_t length) {
+    if (!log || log->failed) {
+	return;
+    }
+    if (log->length + length > log->size) {
+	size_t newSize = (size_t)(log->size * RESIZING_FACTOR) + length;
+	char* newData = (char*)realloc(log->data, newSize);
+	if (!newData) {
+	    // Later (smaller) appends must not leave a gap in the records
+	    log->failed = true;
+	    return;
+	}
+	log->data = newData;
+	log->size = newSize;
+    }
+    memcpy(log->data + log->length, data, length);
+    log->length += length;
+}
+
+void log_game_move(GameLog* log, HapDetails* move) {
+    GameLogMove record = {.playerID = move->playerID,
+	    .newSite = move->newSite,
+	    .additionalPoints = move->additionalPoints,
+	    .moneyChange = move->moneyChange, .cardDrawn = move->cardDrawn};
+    append_game_log(log, &record, sizeof(GameLogMove));
+    if (log) {
+	log->numMoves++;
+    }
+}
+
+bool finish_game_log(GameLog* log, Game* game, int gameError) {
+    if (!log) {
+	return true;
+    }
+    if (!log->failed) {
+	memcpy(log->data + offsetof(GameLogHeader, numMoves),
+		&log->numMoves, sizeof(uint32_t));
+    }
+    GameLogMove end = {.playerID = GAME_LOG_END, .newSite = gameError};
+    append_game_log(log, &end, sizeof(GameLogMove));
+    for (int player = 0; game && player < game->playerCount; player++) {
+	int32_t score = game->players[player]->numPoints;
+	append_game_log(log, &score, sizeof(int32_t));
+    }
+    // The whole game is written at once, so that games logged to the same
+    // file at the same time are not interleaved
+    bool written = false;
+    int logFd = log->failed ? -1 : open(log->fileName, O_WRONLY | O_APPEND |
+	    O_CREAT | O_CLOEXEC, 0644);
+    if (logFd != -1) {
+	written = write(logFd, log->data, log->length) ==
+		(ssize_t)log->length;
+	close(logFd);
+    }
+    free(log->data);
+    free(log);
+    return written;
+}
@@ -0,0 +1,107 @@
+#ifndef GAME_LOG_H
+#define GAME_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "2310X.h"
+
+/* If this environment variable is set, the dealer appends a binary log of
+ * each game it hosts to the file it names, which 2310replay can replay
+ * without any player processes. Each game is written with a single write()
+ * once it is over, so several dealers (or tables of a server) may share one
+ * log file.
+ *
+ * A game's log is a GameLogHeader, followed by the path (pathLength chars,
+ * as sent to players without the newline) and the lineup (lineupLength
+ * chars: each player program, null-terminated), then one GameLogMove per
+ * move. It ends with a GameLogMove whose playerID is GAME_LOG_END and whose
+ * newSite is the dealer exit code the game ended with. If the game ended
+ * normally, the final score of each player follows, as int32_t. All values
+ * are in the byte order of the machine that wrote them. */
+#define GAME_LOG_ENV "GAME_LOG"
+
+/* Identifies a game log (including the null terminator), and the version of
+ * the log format */
+#define GAME_LOG_MAGIC "2310LOG"
+#define GAME_LOG_MAGIC_SIZE 8
+#define GAME_LOG_VERSION 1
+
+/* Player ID of the record that ends a game's log */
+#define GAME_LOG_END (-1)
+
+/* Seed and multiplier of the 64-bit FNV-1a hash */
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/* Header of a game's log */
+typedef struct {
+    char magic[GAME_LOG_MAGIC_SIZE];
+    uint32_t version;
+
+    // Number of the game (as printed by the dealer), and its player count
+    uint32_t gameNumber;
+    uint32_t playerCount;
+
+    // Number of moves logged (i.e. GameLogMoves before the end record)
+    uint32_t numMoves;
+
+    // Lengths of the path and lineup that follow the header
+    uint32_t pathLength;
+    uint32_t lineupLength;
+
+    // Hashes (see hash_text()) of the deck and path file contents
+    uint64_t deckHash;
+    uint64_t pathHash;
+} GameLogHeader;
+
+/* A move of the game (i.e. the details of its HAP message), or the end of
+ * the game's log */
+typedef struct {
+    int32_t playerID;
+    int32_t newSite;
+    int32_t additionalPoints;
+    int32_t moneyChange;
+    int32_t cardDrawn;
+} GameLogMove;
+
+/* Log of a game in progress, kept in memory until the game is over */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t size;
+    char* fileName;
+    uint32_t numMoves;
+
+    // Whether an append failed (running out of memory). The log is then
+    // incomplete, so nothing more is appended and it is not written.
+    bool failed;
+} GameLog;
+
+/* Takes in some text. Returns its 64-bit FNV-1a hash. */
+uint64_t hash_text(const char* text);
+
+/* Takes in the number of the game, the (validated) deck and path, the player
+ * count and the player programs. Starts the log of a new game. Returns NULL
+ * if games are not being logged (see GAME_LOG_ENV). */
+GameLog* start_game_log(int gameNumber, char* deck, char* path,
+	int playerCount, char** programs);
+
+/* Takes in a game's log (or NULL), and data of the given length. Appends
+ * said data to the log, unless an earlier append failed. */
+void append_game_log(GameLog* log, const void* data, size_t length);
+
+/* Takes in a game's log (or NULL), and the details of a move. Appends said
+ * move to the log. */
+void log_game_move(GameLog* log, HapDetails* move);
+
+/* Takes in a game's log (or NULL), the game (NULL if it did not end
+ * normally, otherwise its final scores must have been calculated), and the
+ * dealer exit code it ended with. Ends the log, appends it to the log file
+ * (unless it is incomplete, see GameLog), and frees it. Returns false if the
+ * log could not be written. */
+bool finish_game_log(GameLog* log, Game* game, int gameError);
+
+#endif
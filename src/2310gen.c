@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <getopt.h>
+#include "2310X.h"
+#include "2310dealer.h"
+#include "2310gen.h"
+
+/* Options shared by the deck and path modes */
+static struct option generatorOptions[] = {
+    {"cards", required_argument, NULL, 'c'},
+    {"preset", required_argument, NULL, 'p'},
+    {"mix", required_argument, NULL, 'm'},
+    {"limit", required_argument, NULL, 'l'},
+    {"barriers", required_argument, NULL, 'b'},
+    {"seed", required_argument, NULL, 's'},
+    {NULL, 0, NULL, 0}
+};
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && !strcmp(argv[1], "deck")) {
+	return generate_deck(argc - 1, argv + 1);
+    } else if (argc >= 2 && !strcmp(argv[1], "path")) {
+	return generate_path(argc - 1, argv + 1);
+    } else if (argc >= 2 && !strcmp(argv[1], "requests")) {
+	return generate_requests(argc - 1, argv + 1);
+    }
+    fprintf(stderr, GENERATOR_USAGE);
+    return EXIT_FAILURE;
+}
+
+int generate_deck(int argc, char** argv) {
+    char* cards = "ABCDE";
+    int seed = 0;
+    int numCards = 0;
+    int option;
+    while ((option = getopt_long(argc, argv, "", generatorOptions, NULL)) !=
+	    -1) {
+	if (option == 'c' && strlen(optarg) &&
+		strspn(optarg, "ABCDE") == strlen(optarg)) {
+	    cards = optarg;
+	} else if (option != 's' || !parse_number(optarg, 0, &seed)) {
+	    fprintf(stderr, GENERATOR_USAGE);
+	    return EXIT_FAILURE;
+	}
+    }
+    if (optind != argc - 1 || !parse_number(argv[optind],
+	    MIN_NUM_CARDS_IN_DECK, &numCards)) {
+	fprintf(stderr, GENERATOR_USAGE);
+	return EXIT_FAILURE;
+    }
+    srandom(seed);
+    printf("%d", numCards);
+    int numCardTypes = strlen(cards);
+    for (int card = 0; card < numCards; card++) {
+	putchar(cards[random() % numCardTypes]);
+    }
+    printf("\n");
+    return EXIT_SUCCESS;
+}
+
+int generate_path(int argc, char** argv) {
+    PathSettings settings;
+    init_path_settings(&settings, 0);
+    int seed = 0;
+    int option;
+    bool validOptions = true;
+    while (validOptions && (option = getopt_long(argc, argv, "",
+	    generatorOptions, NULL)) != -1) {
+	switch (option) {
+	    case 'p':
+		validOptions = apply_preset(&settings, optarg);
+		break;
+	    case 'm':
+		validOptions = parse_site_mix(&settings, optarg);
+		break;
+	    case 'l':
+		validOptions = parse_number(optarg, MIN_SITE_LIMIT,
+			&settings.limit) && settings.limit <= MAX_SITE_LIMIT;
+		break;
+	    case 'b':
+		validOptions = parse_number(optarg, 0,
+			&settings.barrierPercent) &&
+			settings.barrierPercent <= 100;
+		break;
+	    case 's':
+		validOptions = parse_number(optarg, 0, &seed);
+		break;
+	    default:
+		validOptions = false;
+		break;
+	}
+    }
+    if (!validOptions || optind != argc - 1 || !parse_number(argv[optind],
+	    MIN_SITES, &settings.numSites)) {
+	fprintf(stderr, GENERATOR_USAGE);
+	return EXIT_FAILURE;
+    }
+
+    write_path(stdout, &settings, seed);
+    printf("\n");
+    return EXIT_SUCCESS;
+}
+
+int generate_requests(int argc, char** argv) {
+    // Mode, number of games, deck, path, number of players and at least one
+    // player program
+    int numGames = 0;
+    int numPlayers = 0;
+    if (argc < 6 || !parse_number(argv[1], 1, &numGames) ||
+	    !parse_number(argv[4], 1, &numPlayers)) {
+	fprintf(stderr, GENERATOR_USAGE);
+	return EXIT_FAILURE;
+    }
+    char** players = argv + 5;
+    int numPrograms = argc - 5;
+    int nextProgram = 0;
+    for (int game = 0; game < numGames; game++) {
+	printf("%s %s", argv[2], argv[3]);
+	for (int player = 0; player < numPlayers; player++) {
+	    printf(" %s", players[nextProgram]);
+	    nextProgram = (nextProgram + 1) % numPrograms;
+	}
+	printf("\n");
+    }
+    return EXIT_SUCCESS;
+}
+
+bool apply_preset(PathSettings* settings, char* preset) {
+    if (!strcmp(preset, "capacity1")) {
+	// Every site but the barriers holds one player
+	settings->limit = MIN_SITE_LIMIT;
+    } else if (!strcmp(preset, "barriers")) {
+	// No site may be skipped
+	settings->barrierPercent = 100;
+    } else if (!strcmp(preset, "nobarriers")) {
+	// Players may move anywhere up to the final site
+	settings->barrierPercent = 0;
+    } else if (!strcmp(preset, "ri")) {
+	// Mostly Ri sites, i.e. a card drawn on most moves
+	for (int type = 0; type < NUM_WEIGHTED_SITE_TYPES; type++) {
+	    settings->typeWeights[type] = (type == SITE_RI) ? 8 : 1;
+	}
+    } else {
+	return false;
+    }
+    return true;
+}
+
+bool parse_site_mix(PathSettings* settings, char* mix) {
+    const char* siteTypes[NUM_WEIGHTED_SITE_TYPES] = WEIGHTED_SITE_TYPES;
+    for (int type = 0; type < NUM_WEIGHTED_SITE_TYPES; type++) {
+	settings->typeWeights[type] = 0;
+    }
+    for (char* entry = strtok(mix, ","); entry; entry = strtok(NULL, ",")) {
+	char* weight = strchr(entry, '=');
+	if (!weight) {
+	    return false;
+	}
+	*weight++ = '\0';
+	int type = 0;
+	while (type < NUM_WEIGHTED_SITE_TYPES && strcmp(entry,
+		siteTypes[type])) {
+	    type++;
+	}
+	if (type == NUM_WEIGHTED_SITE_TYPES ||
+		!parse_number(weight, 0, &settings->typeWeights[type]) ||
+		settings->typeWeights[type] > MAX_SITE_WEIGHT) {
+	    return false;
+	}
+    }
+    // A type listed more than once takes its last weight
+    int totalWeight = 0;
+    for (int type = 0; type < NUM_WEIGHTED_SITE_TYPES; type++) {
+	totalWeight += settings->typeWeights[type];
+    }
+    return totalWeight > 0;
+}
+
+bool parse_number(char* input, int min, int* number) {
+    char* inputErrors = NULL;
+    long value = strtol(input, &inputErrors, 10);
+    if (!strlen(input) || *inputErrors || value < min || value > INT_MAX) {
+	return false;
+    }
+    *number = value;
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "2310X.h"
+#include "2310pathgen.h"
+
+/* Usage of the workload generator. Each mode writes one file's contents to
+ * stdout, in the format the dealer accepts:
+ *   2310gen deck numCards [--cards ABCDE] [--seed n]
+ *   2310gen path numSites [--preset name] [--mix Mo=w,V1=w,...]
+ *	     [--limit n] [--barriers percent] [--seed n]
+ *   2310gen requests numGames deck path numPlayers player {player}
+ * Each weight w of the path mode's site type mix is 0 to MAX_SITE_WEIGHT.
+ * requests writes game requests for the dealer's server mode, each with
+ * numPlayers players taken in turn from the given player programs. */
+#define GENERATOR_USAGE "Usage: 2310gen deck numCards [--cards ABCDE] " \
+	"[--seed n]\n" \
+	"       2310gen path numSites [--preset capacity1|barriers|" \
+	"nobarriers|ri]\n" \
+	"           [--mix Mo=w,V1=w,V2=w,Do=w,Ri=w] [--limit 1-9] " \
+	"[--barriers 0-100] [--seed n]\n" \
+	"       2310gen requests numGames deck path numPlayers player " \
+	"{player}\n"
+
+/* Takes in the command-line arguments after the mode. Writes a deck of the
+ * requested number of cards to stdout. Returns the exit status. */
+int generate_deck(int argc, char** argv);
+
+/* Takes in the command-line arguments after the mode. Writes a path
+ * generated with the requested settings to stdout. Returns the exit status.
+ * */
+int generate_path(int argc, char** argv);
+
+/* Takes in the command-line arguments after the mode. Writes the requested
+ * number of game requests to stdout. Returns the exit status. */
+int generate_requests(int argc, char** argv);
+
+/* Takes in the path settings, and the name of a preset. Applies said preset
+ * to the settings. Returns false if there is no such preset. */
+bool apply_preset(PathSettings* settings, char* preset);
+
+/* Takes in the path settings, and a site type mix (e.g. Mo=2,Ri=1). Sets the
+ * weight of each site type listed, and of every other type to 0. Returns
+ * false if the mix is invalid, gives a type a weight over MAX_SITE_WEIGHT,
+ * or gives every type a weight of 0. */
+bool parse_site_mix(PathSettings* settings, char* mix);
+
+/* Takes in a string, and a pointer to store a number in. Parses said string
+ * as a whole number of at least min. Returns if successful. */
+bool parse_number(char* input, int min, int* number);
+
+#endif
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include "2310io.h"
+#include "2310X.h"
+
+void init_line_buffer(LineBuffer* buffer, size_t limit) {
+    buffer->size = INITIAL_BUFFER_SIZE;
+    buffer->data = (char*)malloc(buffer->size * sizeof(char));
+    buffer->start = 0;
+    buffer->length = 0;
+    buffer->limit = limit;
+}
+
+void free_line_buffer(LineBuffer* buffer) {
+    free(buffer->data);
+    buffer->data = NULL;
+}
+
+ReadStatus fill_line_buffer(LineBuffer* buffer, int fd) {
+    // Lines already handed out are no longer needed, so move any unread data
+    // to the front of the buffer to make room
+    if (buffer->start) {
+	memmove(buffer->data, buffer->data + buffer->start,
+		buffer->length - buffer->start);
+	buffer->length -= buffer->start;
+	buffer->start = 0;
+    }
+
+    while (true) {
+	// Ensure space is available, keeping room for a null terminator
+	if (buffer->length + 1 >= buffer->size) {
+	    size_t newSize = (size_t)(buffer->size * RESIZING_FACTOR) + 1;
+	    char* newData = (char*)realloc(buffer->data, newSize);
+	    if (!newData) {
+		return READ_ERROR;
+	    }
+	    buffer->data = newData;
+	    buffer->size = newSize;
+	}
+	ssize_t numRead = read(fd, buffer->data + buffer->length,
+		buffer->size - buffer->length - 1);
+	if (numRead > 0) {
+	    buffer->length += numRead;
+	    // The reader is not keeping up, so stop rather than grow the
+	    // buffer without bound
+	    if (buffer->length > buffer->limit) {
+		return READ_OVERFLOW;
+	    }
+	} else if (!numRead) {
+	    // As with get_line(), a final line need not be newline-terminated
+	    if (buffer->length > buffer->start &&
+		    buffer->data[buffer->length - 1] != '\n') {
+		buffer->data[(buffer->length)++] = '\n';
+	    }
+	    return READ_EOF;
+	} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	    return READ_MORE; // Everything available has been read
+	} else if (errno != EINTR) {
+	    return READ_ERROR;
+	}
+    }
+}
+
+bool next_line(LineBuffer* buffer, char** line) {
+    char* unread = buffer->data + buffer->start;
+    char* newline = (char*)memchr(unread, '\n', buffer->length -
+	    buffer->start);
+    if (!newline) {
+	return false;
+    }
+    *newline = '\0';
+    buffer->start += newline - unread + 1;
+    *line = unread;
+    return true;
+}
+
+int next_char(LineBuffer* buffer) {
+    if (buffer->start == buffer->length) {
+	return EOF;
+    }
+    return (unsigned char)buffer->data[(buffer->start)++];
+}
+
+void init_outbound_queue(OutboundQueue* queue, size_t limit) {
+    queue->size = INITIAL_BUFFER_SIZE;
+    queue->data = (char*)malloc(queue->size * sizeof(char));
+    queue->start = 0;
+    queue->length = 0;
+    queue->limit = limit;
+    queue->closed = false;
+}
+
+void free_outbound_queue(OutboundQueue* queue) {
+    free(queue->data);
+    queue->data = NULL;
+}
+
+WriteStatus queue_message(OutboundQueue* queue, int fd, const char* message,
+	size_t messageLength) {
+    if (queue->closed) {
+	return WRITE_CLOSED;
+    }
+    // Data must be written in order, so only write straight away if nothing
+    // is waiting
+    if (!outbound_pending(queue)) {
+	queue->start = 0;
+	queue->length = 0;
+	while (messageLength) {
+	    ssize_t numWritten = write(fd, message, messageLength);
+	    if (numWritten >= 0) {
+		message += numWritten;
+		messageLength -= numWritten;
+	    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+		break; // Queue the rest
+	    } else if (errno != EINTR) {
+		queue->closed = true;
+		return WRITE_CLOSED;
+	    }
+	}
+	if (!messageLength) {
+	    return WRITE_OK;
+	}
+    }
+    if (queue->length - queue->start + messageLength > queue->limit) {
+	return WRITE_OVERFLOW;
+    }
+    // Data already written is no longer needed, so move any waiting data to
+    // the front of the queue to make room
+    if (queue->start) {
+	memmove(queue->data, queue->data + queue->start,
+		queue->length - queue->start);
+	queue->length -= queue->start;
+	queue->start = 0;
+    }
+    if (queue->length + messageLength > queue->size) {
+	size_t newSize = queue->size;
+	while (queue->length + messageLength > newSize) {
+	    newSize = (size_t)(newSize * RESIZING_FACTOR) + 1;
+	}
+	queue->data = (char*)realloc(queue->data, newSize);
+	queue->size = newSize;
+    }
+    memcpy(queue->data + queue->length, message, messageLength);
+    queue->length += messageLength;
+    return WRITE_OK;
+}
+
+WriteStatus flush_outbound_queue(OutboundQueue* queue, int fd) {
+    while (outbound_pending(queue)) {
+	ssize_t numWritten = write(fd, queue->data + queue->start,
+		queue->length - queue->start);
+	if (numWritten >= 0) {
+	    queue->start += numWritten;
+	} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	    return WRITE_OK; // Try again once the reader catches up
+	} else if (errno != EINTR) {
+	    // Nobody is left to read the waiting data
+	    queue->closed = true;
+	    queue->start = queue->length;
+	    return WRITE_CLOSED;
+	}
+    }
+    return WRITE_OK;
+}
+
+bool outbound_pending(OutboundQueue* queue) {
+    return queue->start < queue->length;
+}
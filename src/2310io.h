@@ -0,0 +1,114 @@
+#ifndef DEALER_IO_H
+#define DEALER_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+
+/* Most bytes that may be received from a player and not yet processed.
+ * Players only send short lines, and only when asked to, so a player that
+ * sends more is treated as a communication error. */
+#define INBOUND_BUFFER_LIMIT (4 * 1024)
+
+/* Most bytes that may wait to be written to a player that is not keeping up
+ * with the game (on top of the pipe's own buffer). A player that falls
+ * further behind is treated as a communication error. */
+#define OUTBOUND_QUEUE_LIMIT (64 * 1024)
+
+/* Result of reading from a file descriptor into a line buffer. */
+typedef enum {
+    READ_MORE = 0,      // Data was read, or none is available yet
+    READ_EOF = 1,       // The other end has been closed
+    READ_ERROR = 2,     // read() failed
+    READ_OVERFLOW = 3   // The buffer limit has been exceeded
+} ReadStatus;
+
+/* Result of writing to a file descriptor via an outbound queue. */
+typedef enum {
+    WRITE_OK = 0,       // Written, or queued to be written later
+    WRITE_CLOSED = 1,   // The other end has been closed, data is discarded
+    WRITE_OVERFLOW = 2  // The queue limit has been exceeded
+} WriteStatus;
+
+/* Buffer of data read from a (non-blocking) file descriptor, which is handed
+ * out one line at a time. Bytes in [start, length) have not been handed out.
+ * */
+typedef struct {
+    char* data;
+    size_t start;
+    size_t length;
+    size_t size;
+
+    // Most bytes that may be waiting to be handed out at once
+    size_t limit;
+} LineBuffer;
+
+/* Takes in an uninitialised line buffer, and the most bytes that may be
+ * waiting in it at once. Initialises it to be empty, with an initial capacity
+ * of INITIAL_BUFFER_SIZE bytes. */
+void init_line_buffer(LineBuffer* buffer, size_t limit);
+
+/* Takes in a line buffer. Frees the memory associated to said buffer. */
+void free_line_buffer(LineBuffer* buffer);
+
+/* Takes in a line buffer and a (non-blocking) file descriptor to read from.
+ * Appends all data currently available on the file descriptor to the buffer,
+ * growing it if necessary, and returns the appropriate read status. Stops
+ * reading once more than the buffer's limit is waiting. On EOF, an
+ * unterminated final line is terminated so that it can still be read. */
+ReadStatus fill_line_buffer(LineBuffer* buffer, int fd);
+
+/* Takes in a line buffer, and a pointer to store the next line in. If a
+ * complete (newline-terminated) line is buffered, points *line at said line
+ * (with the newline replaced by a null terminator) and returns true. The line
+ * remains valid until the buffer is next filled. */
+bool next_line(LineBuffer* buffer, char** line);
+
+/* Takes in a line buffer, and reads (and returns) its next unread character,
+ * or EOF if no characters are buffered. Used for the single char player
+ * handshake (^), which is not newline-terminated. */
+int next_char(LineBuffer* buffer);
+
+/* Bounded queue of data waiting to be written to a (non-blocking) file
+ * descriptor, whose reader is not keeping up. Bytes in [start, length) have
+ * not been written yet. */
+typedef struct {
+    char* data;
+    size_t start;
+    size_t length;
+    size_t size;
+
+    // Most bytes that may be waiting at once, and whether the reader has
+    // gone (in which case nothing more is queued)
+    size_t limit;
+    bool closed;
+} OutboundQueue;
+
+/* Takes in an uninitialised outbound queue, and the most bytes that may be
+ * waiting in it at once. Initialises it to be empty. */
+void init_outbound_queue(OutboundQueue* queue, size_t limit);
+
+/* Takes in an outbound queue. Frees the memory associated to said queue. */
+void free_outbound_queue(OutboundQueue* queue);
+
+/* Takes in an outbound queue, its (non-blocking) file descriptor, and a
+ * message of the given length. Writes as much of the message as possible
+ * straight away (if nothing is already waiting), queueing the rest, and
+ * returns the appropriate write status. */
+WriteStatus queue_message(OutboundQueue* queue, int fd, const char* message,
+	size_t messageLength);
+
+/* Takes in an outbound queue and its (non-blocking) file descriptor. Writes
+ * as much of the waiting data as possible, and returns the appropriate write
+ * status. */
+WriteStatus flush_outbound_queue(OutboundQueue* queue, int fd);
+
+/* Takes in an outbound queue. Returns if any data is waiting to be written.
+ * */
+bool outbound_pending(OutboundQueue* queue);
+
+#endif
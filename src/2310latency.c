@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "2310latency.h"
+
+/* Global variable - latencies of the game in progress (NULL if none). */
+LatencyStats* gameLatency = NULL;
+
+/* Global variable - flag set when SIGUSR1 is received. */
+volatile sig_atomic_t latencyReportRequested = 0;
+
+long long monotonic_time_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+LatencyStats* init_latency_stats(int playerCount) {
+    // Histograms start with every count at 0
+    LatencyStats* stats = (LatencyStats*)calloc(1, sizeof(LatencyStats));
+    stats->playerCount = playerCount;
+    stats->players = (LatencyHistogram*)calloc(playerCount,
+	    sizeof(LatencyHistogram));
+    stats->askedAt = (long long*)calloc(playerCount, sizeof(long long));
+    return stats;
+}
+
+void free_latency_stats(LatencyStats* stats) {
+    free(stats->players);
+    free(stats->askedAt);
+    free(stats);
+}
+
+void record_latency(LatencyHistogram* histogram, long long latency) {
+    if (latency < 0) {
+	latency = 0;
+    }
+    // Small latencies are counted exactly. Otherwise, the power of two
+    // picks the group of buckets, and the bits after the leading 1 pick the
+    // bucket within the group.
+    int bucket = latency;
+    if (latency >= LATENCY_SUB_BUCKETS) {
+	int exponent = 63 - __builtin_clzll((unsigned long long)latency);
+	if (exponent > LATENCY_MAX_EXPONENT) {
+	    bucket = LATENCY_NUM_BUCKETS - 1;
+	} else {
+	    int shift = exponent - LATENCY_SUB_BUCKET_BITS;
+	    bucket = (shift + 1) * LATENCY_SUB_BUCKETS +
+		    (int)(latency >> shift) - LATENCY_SUB_BUCKETS;
+	}
+    }
+    histogram->counts[bucket]++;
+    histogram->numRecorded++;
+    if (latency > histogram->max) {
+	histogram->max = latency;
+    }
+}
+
+long long latency_percentile(LatencyHistogram* histogram, double percentile) {
+    if (!histogram->numRecorded) {
+	return 0;
+    }
+    // The rank of the latency wanted, counting from 1
+    long long rank = (long long)(percentile / 100 *
+	    histogram->numRecorded + 0.5);
+    if (rank < 1) {
+	rank = 1;
+    }
+    long long seen = 0;
+    for (int bucket = 0; bucket < LATENCY_NUM_BUCKETS; bucket++) {
+	seen += histogram->counts[bucket];
+	if (seen < rank) {
+	    continue;
+	}
+	// Report the largest latency the bucket holds, which is no more than
+	// the largest latency recorded
+	int group = bucket / LATENCY_SUB_BUCKETS;
+	long long highest = bucket;
+	if (group) {
+	    long long width = 1LL << (group - 1);
+	    highest = (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) *
+		    width + width - 1;
+	}
+	return highest < histogram->max ? highest : histogram->max;
+    }
+    return histogram->max;
+}
+
+void print_latency_summary(FILE* output, const char* label,
+	LatencyHistogram* histogram) {
+    fprintf(output, "%s: n=%lld p50=%.1fus p99=%.1fus max=%.1fus\n", label,
+	    histogram->numRecorded,
+	    latency_percentile(histogram, 50) / NS_PER_US,
+	    latency_percentile(histogram, 99) / NS_PER_US,
+	    histogram->max / NS_PER_US);
+}
+
+void report_latency_stats(FILE* output, LatencyStats* stats) {
+    char label[LATENCY_LABEL_SIZE];
+    for (int player = 0; player < stats->playerCount; player++) {
+	snprintf(label, LATENCY_LABEL_SIZE, "Player %d", player);
+	print_latency_summary(output, label, &stats->players[player]);
+    }
+    print_latency_summary(output, "All players", &stats->allPlayers);
+    print_latency_summary(output, "Dealer", &stats->dealer);
+    const char* phaseNames[NUM_DEALER_PHASES] = DEALER_PHASE_NAMES;
+    for (int phase = 0; phase < NUM_DEALER_PHASES; phase++) {
+	snprintf(label, LATENCY_LABEL_SIZE, "Dealer %s", phaseNames[phase]);
+	print_latency_summary(output, label, &stats->phases[phase]);
+    }
+    fflush(output);
+}
+
+void print_usage_summary(FILE* output, const char* label,
+	struct rusage* usage) {
+    if (!usage) {
+	fprintf(output, "%s usage: unavailable\n", label);
+	return;
+    }
+    fprintf(output, "%s usage: user=%.1fms sys=%.1fms maxrss=%ldKB "
+	    "vcsw=%ld ivcsw=%ld\n", label,
+	    usage->ru_utime.tv_sec * MS_PER_SEC +
+	    usage->ru_utime.tv_usec / US_PER_MS,
+	    usage->ru_stime.tv_sec * MS_PER_SEC +
+	    usage->ru_stime.tv_usec / US_PER_MS,
+	    usage->ru_maxrss, usage->ru_nvcsw, usage->ru_nivcsw);
+}
+
+void request_latency_report(int signal) {
+    latencyReportRequested = 1;
+}
+
+void report_requested_latency(void) {
+    if (!latencyReportRequested) {
+	return;
+    }
+    latencyReportRequested = 0;
+    if (gameLatency) {
+	report_latency_stats(stderr, gameLatency);
+    }
+}
@@ -0,0 +1,132 @@
+#ifndef DEALER_LATENCY_H
+#define DEALER_LATENCY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/* If this environment variable is set, the dealer prints a summary of the
+ * latencies of the game to stderr once it is over. The summary can also be
+ * requested at any time by sending the dealer SIGUSR1. */
+#define LATENCY_REPORT_ENV "DEALER_LATENCY"
+
+/* Latencies (in nanoseconds) are counted in buckets whose width doubles with
+ * each power of two, with 2^LATENCY_SUB_BUCKET_BITS buckets per power of two
+ * (i.e. accurate to about 3%). Latencies of 2^(LATENCY_MAX_EXPONENT + 1) ns
+ * (about 73 minutes) or more share the last bucket. */
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_EXPONENT 41
+#define LATENCY_NUM_BUCKETS ((LATENCY_MAX_EXPONENT - \
+	LATENCY_SUB_BUCKET_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+/* Number of nanoseconds in a microsecond, microseconds in a millisecond, and
+ * milliseconds in a second */
+#define NS_PER_US 1000.0
+#define US_PER_MS 1000.0
+#define MS_PER_SEC 1000.0
+
+/* Labels in the summary are at most "Player " followed by an int */
+#define LATENCY_LABEL_SIZE 32
+
+/* Parts of the dealer's own processing of each move */
+typedef enum {
+    PHASE_VALIDATE = 0,     // Decoding and validating the DO message
+    PHASE_HAP = 1,          // Forming the HAP and updating the game
+    PHASE_BROADCAST = 2,    // Sending the HAP (and YT) to every player
+    PHASE_DISPLAY = 3,      // Displaying the game
+    NUM_DEALER_PHASES = 4
+} DealerPhase;
+
+/* Names of the dealer phases in the summary, in DealerPhase order */
+#define DEALER_PHASE_NAMES {"validate", "hap", "broadcast", "display"}
+
+/* Histogram of latencies, along with the exact number and largest latency
+ * recorded */
+typedef struct {
+    uint32_t counts[LATENCY_NUM_BUCKETS];
+    long long numRecorded;
+    long long max;
+} LatencyHistogram;
+
+/* Latencies of a game */
+typedef struct {
+    int playerCount;
+
+    // Time taken by each player from being sent YT until its DO was
+    // received (or for plugin players, to choose their move), and the same
+    // for every player of the game together. As YT is sent along with the
+    // previous HAP, a player's time only starts once the dealer has finished
+    // processing the previous move, so that the dealer's own time is not
+    // counted against the player.
+    LatencyHistogram* players;
+    LatencyHistogram allPlayers;
+
+    // When each player's time for their current move started, in
+    // nanoseconds
+    long long* askedAt;
+
+    // Time the dealer took to process each move, in total and by phase
+    LatencyHistogram dealer;
+    LatencyHistogram phases[NUM_DEALER_PHASES];
+} LatencyStats;
+
+/* Global variable - latencies of the game in progress (NULL if none), which
+ * are reported on SIGUSR1. */
+extern LatencyStats* gameLatency;
+
+/* Global variable - flag set when SIGUSR1 is received, until the latencies
+ * have been reported. */
+extern volatile sig_atomic_t latencyReportRequested;
+
+/* Returns the current time of the monotonic clock in nanoseconds. */
+long long monotonic_time_ns(void);
+
+/* Takes in the player count. Returns the (empty) latencies of a new game. */
+LatencyStats* init_latency_stats(int playerCount);
+
+/* Takes in the latencies of a game. Frees the memory associated to them. */
+void free_latency_stats(LatencyStats* stats);
+
+/* Takes in a histogram and a latency in nanoseconds. Counts said latency. */
+void record_latency(LatencyHistogram* histogram, long long latency);
+
+/* Takes in a histogram and a percentile (0 to 100). Returns the latency (in
+ * nanoseconds) that said percentage of the recorded latencies are no larger
+ * than, to within the accuracy of the histogram, or 0 if none have been
+ * recorded. */
+long long latency_percentile(LatencyHistogram* histogram, double percentile);
+
+/* Takes in a file, a label and a histogram. Prints one line summarising the
+ * histogram (the number recorded, then the p50, p99 and max in
+ * microseconds). */
+void print_latency_summary(FILE* output, const char* label,
+	LatencyHistogram* histogram);
+
+/* Takes in a file and the latencies of a game. Prints the summary of each
+ * player, the game as a whole, and the dealer's processing. */
+void report_latency_stats(FILE* output, LatencyStats* stats);
+
+/* Takes in a file, a label and the resource usage of a process (or NULL if
+ * it is unavailable). Prints one line summarising its user and system CPU
+ * time (in milliseconds), max RSS (in kilobytes), and voluntary and
+ * involuntary context switches. */
+void print_usage_summary(FILE* output, const char* label,
+	struct rusage* usage);
+
+/* Takes in a signal from the kernel (SIGUSR1 specifically). Requests that the
+ * latencies of the game in progress are reported. Reporting is left to the
+ * dealer's main loop (see report_requested_latency()), as stdio is not safe
+ * to use in a signal handler. */
+void request_latency_report(int signal);
+
+/* Reports the latencies of the game in progress to stderr if SIGUSR1 has been
+ * received since they were last reported. */
+void report_requested_latency(void);
+
+#endif
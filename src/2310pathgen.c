@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "2310X.h"
+#include "2310pathgen.h"
+
+void init_path_settings(PathSettings* settings, int numSites) {
+    settings->numSites = numSites;
+    for (int type = 0; type < NUM_WEIGHTED_SITE_TYPES; type++) {
+	settings->typeWeights[type] = 1;
+    }
+    settings->limit = 0;
+    settings->barrierPercent = DEFAULT_BARRIER_PERCENT;
+}
+
+void write_path(FILE* output, PathSettings* settings, unsigned int seed) {
+    const char* siteTypes[NUM_WEIGHTED_SITE_TYPES] = WEIGHTED_SITE_TYPES;
+    srandom(seed);
+    fprintf(output, "%d;", settings->numSites);
+    for (int site = 0; site < settings->numSites; site++) {
+	// Every path starts and ends with a barrier
+	if (!site || site == settings->numSites - 1 ||
+		random() % 100 < settings->barrierPercent) {
+	    fprintf(output, "::-");
+	    continue;
+	}
+	int limit = settings->limit ? settings->limit : MIN_SITE_LIMIT +
+		random() % (MAX_SITE_LIMIT - MIN_SITE_LIMIT + 1);
+	fprintf(output, "%s%d", siteTypes[choose_site_type(settings)], limit);
+    }
+}
+
+int choose_site_type(PathSettings* settings) {
+    int totalWeight = 0;
+    for (int type = 0; type < NUM_WEIGHTED_SITE_TYPES; type++) {
+	totalWeight += settings->typeWeights[type];
+    }
+    int choice = random() % totalWeight;
+    int type = 0;
+    while (choice >= settings->typeWeights[type]) {
+	choice -= settings->typeWeights[type++];
+    }
+    return type;
+}
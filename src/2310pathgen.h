@@ -0,0 +1,56 @@
+#ifndef PATH_GENERATOR_H
+#define PATH_GENERATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "2310X.h"
+
+/* Site types that may be generated (other than barriers), in SiteType order
+ * */
+#define NUM_WEIGHTED_SITE_TYPES 5
+#define WEIGHTED_SITE_TYPES {"Mo", "V1", "V2", "Do", "Ri"}
+
+/* Largest weight of a site type, so that the total weight cannot overflow */
+#define MAX_SITE_WEIGHT 1000
+
+/* Site limits are a single digit */
+#define MIN_SITE_LIMIT 1
+#define MAX_SITE_LIMIT 9
+
+/* Barriers are placed at this percentage of sites (other than the first and
+ * last, which are always barriers) unless specified. */
+#define DEFAULT_BARRIER_PERCENT 10
+
+/* Path generation settings */
+typedef struct {
+    int numSites;
+
+    // Relative weight of each site type (see WEIGHTED_SITE_TYPES), each at
+    // most MAX_SITE_WEIGHT
+    int typeWeights[NUM_WEIGHTED_SITE_TYPES];
+
+    // Limit of every non-barrier site, or 0 for random limits
+    int limit;
+
+    // Percentage of sites (other than the first and last) that are barriers
+    int barrierPercent;
+} PathSettings;
+
+/* Takes in the path settings and a number of sites. Sets the settings to
+ * the defaults for a path of said length (every site type equally likely,
+ * random limits, and DEFAULT_BARRIER_PERCENT barriers). */
+void init_path_settings(PathSettings* settings, int numSites);
+
+/* Takes in a stream, the path settings and a random seed. Writes a path
+ * generated with said settings (as read from a path file, without the
+ * newline) to the stream. The same settings and seed always give the same
+ * path. */
+void write_path(FILE* output, PathSettings* settings, unsigned int seed);
+
+/* Takes in the path settings. Randomly chooses (and returns) the index of a
+ * site type, according to their weights. */
+int choose_site_type(PathSettings* settings);
+
+#endif
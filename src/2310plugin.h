@@ -0,0 +1,45 @@
+#ifndef STRATEGY_PLUGIN_H
+#define STRATEGY_PLUGIN_H
+
+#include <stdbool.h>
+#include "2310X.h"
+
+/* Version of the strategy plugin interface. Plugins are handed the game and
+ * player representations directly, hence this must be bumped whenever the
+ * layout of StrategyPlugin, Game, Path, Site or Player changes. */
+#define STRATEGY_PLUGIN_ABI_VERSION 5
+
+/* Name of the StrategyPlugin symbol that every plugin must export. */
+#define STRATEGY_PLUGIN_SYMBOL "strategy_plugin"
+
+/* The file extension of a plugin. Dealer player arguments ending with this
+ * extension are loaded in-process rather than started as a process. */
+#define STRATEGY_PLUGIN_EXTENSION ".so"
+
+/* Strategy plugin representation. A plugin is a shared object exporting a
+ * StrategyPlugin named strategy_plugin. Each plugin player is given its own
+ * game representation, kept up to date by the dealer, which the plugin should
+ * only read. Moves are validated exactly as DO messages from a player process
+ * would be. */
+typedef struct {
+    // Must be STRATEGY_PLUGIN_ABI_VERSION
+    int abiVersion;
+
+    // Name of the strategy, e.g. "2310A"
+    const char* name;
+
+    // Optional (may be NULL). Takes in the game representation and this
+    // player's representation, once the path is known but before any move
+    // is made. Returns if the plugin is ready to play.
+    bool (*init)(Game* game, Player* thisPlayer);
+
+    // Required. Same contract as the moveStrategy passed to play_game(), i.e.
+    // returns the site number of the next move to be made.
+    int (*moveStrategy)(Game* game, Player* thisPlayer);
+
+    // Optional (may be NULL). Takes in the game representation and this
+    // player's representation once the game is over (normally or not).
+    void (*teardown)(Game* game, Player* thisPlayer);
+} StrategyPlugin;
+
+#endif
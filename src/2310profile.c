@@ -0,0 +1,164 @@
+/* dladdr() and program_invocation_short_name are GNU extensions */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include "2310profile.h"
+
+/* Samples taken so far (allocated up front, as the signal handler cannot
+ * allocate), and whether samples are being taken. */
+static StackSample* samples = NULL;
+static volatile sig_atomic_t numSamples = 0;
+static volatile sig_atomic_t sampling = 0;
+
+/* The timer that raises SIGPROF */
+static timer_t sampleTimer;
+
+void start_sampling_profiler(void) {
+    if (!getenv(SAMPLING_PROFILE_ENV)) {
+	return;
+    }
+    samples = (StackSample*)malloc(MAX_SAMPLES * sizeof(StackSample));
+    if (!samples) {
+	return;
+    }
+    // backtrace() loads the unwinder the first time it is called, which is
+    // not safe in a signal handler
+    void* warmUp[1];
+    backtrace(warmUp, 1);
+
+    struct sigaction sigprofHandlingSetup;
+    memset(&sigprofHandlingSetup, 0, sizeof(struct sigaction));
+    sigprofHandlingSetup.sa_handler = take_stack_sample;
+    sigprofHandlingSetup.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &sigprofHandlingSetup, NULL);
+
+    if (!start_sample_timer()) {
+	free(samples);
+	samples = NULL;
+	return;
+    }
+    pthread_atfork(NULL, NULL, restart_sampling_profiler);
+    atexit(write_stack_samples);
+}
+
+void take_stack_sample(int signal) {
+    if (!sampling || numSamples >= MAX_SAMPLES) {
+	return;
+    }
+    int savedErrno = errno;
+    StackSample* sample = &samples[numSamples];
+    sample->depth = backtrace(sample->frames, MAX_SAMPLE_DEPTH);
+    numSamples++;
+    errno = savedErrno;
+}
+
+bool start_sample_timer(void) {
+    struct sigevent timerEvent;
+    memset(&timerEvent, 0, sizeof(struct sigevent));
+    timerEvent.sigev_notify = SIGEV_SIGNAL;
+    timerEvent.sigev_signo = SIGPROF;
+    if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &timerEvent, &sampleTimer)) {
+	return false;
+    }
+    struct itimerspec interval = {
+	    .it_interval = {.tv_sec = 0, .tv_nsec = SAMPLE_INTERVAL_NS},
+	    .it_value = {.tv_sec = 0, .tv_nsec = SAMPLE_INTERVAL_NS}};
+    sampling = 1;
+    if (timer_settime(sampleTimer, 0, &interval, NULL)) {
+	sampling = 0;
+	timer_delete(sampleTimer);
+	return false;
+    }
+    return true;
+}
+
+void restart_sampling_profiler(void) {
+    numSamples = 0;
+    sampling = 0;
+    start_sample_timer();
+}
+
+void write_stack_samples(void) {
+    if (!sampling) {
+	return;
+    }
+    sampling = 0;
+    timer_delete(sampleTimer);
+
+    char fileName[MAX_PROFILE_FILE_SIZE];
+    snprintf(fileName, MAX_PROFILE_FILE_SIZE, "%s/%s.%d.folded",
+	    getenv(SAMPLING_PROFILE_ENV), program_invocation_short_name,
+	    (int)getpid());
+    FILE* profileFile = fopen(fileName, "w");
+    if (!profileFile) {
+	return;
+    }
+    // Identical stacks are counted together, by sorting the folded stacks
+    char** folded = (char**)malloc(numSamples * sizeof(char*));
+    for (int i = 0; i < numSamples; i++) {
+	folded[i] = (char*)malloc(MAX_FOLDED_STACK_SIZE * sizeof(char));
+	fold_stack_sample(&samples[i], folded[i]);
+    }
+    qsort(folded, numSamples, sizeof(char*), compare_folded_stacks);
+    int count = 0;
+    for (int i = 0; i < numSamples; i++) {
+	count++;
+	if (i == numSamples - 1 || strcmp(folded[i], folded[i + 1])) {
+	    fprintf(profileFile, "%s %d\n", folded[i], count);
+	    count = 0;
+	}
+    }
+    for (int i = 0; i < numSamples; i++) {
+	free(folded[i]);
+    }
+    free(folded);
+    free(samples);
+    fclose(profileFile);
+}
+
+void fold_stack_sample(StackSample* sample, char* folded) {
+    size_t length = 0;
+    folded[0] = '\0';
+    // Outermost frame first. Each frame (but the innermost, where the
+    // process was interrupted) is a return address, which may be just past
+    // the end of the calling function.
+    for (int frame = sample->depth - 1; frame >= SAMPLE_HANDLER_FRAMES;
+	    frame--) {
+	char* address = (char*)sample->frames[frame];
+	if (frame > SAMPLE_HANDLER_FRAMES) {
+	    address--;
+	}
+	Dl_info symbol;
+	const char* name = "[unknown]";
+	if (dladdr(address, &symbol)) {
+	    if (symbol.dli_sname) {
+		name = symbol.dli_sname;
+	    } else if (symbol.dli_fname) {
+		// Not an exported function, so only the file is known
+		const char* fileName = strrchr(symbol.dli_fname, '/');
+		name = fileName ? fileName + 1 : symbol.dli_fname;
+	    }
+	}
+	int written = snprintf(folded + length,
+		MAX_FOLDED_STACK_SIZE - length, "%s%s",
+		length ? ";" : "", name);
+	if (written < 0 || length + written >= MAX_FOLDED_STACK_SIZE) {
+	    break; // Too deep to show in full
+	}
+	length += written;
+    }
+}
+
+int compare_folded_stacks(const void* first, const void* second) {
+    return strcmp(*(char* const*)first, *(char* const*)second);
+}
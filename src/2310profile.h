@@ -0,0 +1,69 @@
+#ifndef SAMPLING_PROFILE_H
+#define SAMPLING_PROFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* If this environment variable is set (to a directory), the dealer and
+ * player programs sample their own call stacks while running, and write
+ * them to <directory>/<program>.<pid>.folded once they exit. Each line of
+ * said file is a call stack (outermost function first, separated by ;)
+ * followed by the number of samples of it, i.e. the folded stack format
+ * that flame graph tools take. Players inherit the environment, so each
+ * player process writes its own file. */
+#define SAMPLING_PROFILE_ENV "SAMPLING_PROFILE"
+
+/* Stacks are sampled once per this many nanoseconds of CPU time used by the
+ * process (i.e. about 1000 samples per CPU second). */
+#define SAMPLE_INTERVAL_NS 1000000
+
+/* Most samples kept per process (further samples are dropped), and the most
+ * frames kept per sample (the innermost ones). */
+#define MAX_SAMPLES 20000
+#define MAX_SAMPLE_DEPTH 48
+
+/* Frames of the signal handler (and the signal trampoline) at the top of
+ * every sampled stack, which are left out. */
+#define SAMPLE_HANDLER_FRAMES 2
+
+/* Most characters in a (symbolised) folded stack, and in the file name of
+ * the profile. */
+#define MAX_FOLDED_STACK_SIZE 4096
+#define MAX_PROFILE_FILE_SIZE 4096
+
+/* A sampled call stack, innermost frame first */
+typedef struct {
+    int depth;
+    void* frames[MAX_SAMPLE_DEPTH];
+} StackSample;
+
+/* Starts sampling this process's call stack, if SAMPLING_PROFILE_ENV is
+ * set, and arranges for the samples to be written out at exit. Processes
+ * forked from this one (i.e. by a zygote) start their own profile. */
+void start_sampling_profiler(void);
+
+/* Takes in a signal from the kernel (SIGPROF specifically). Records the
+ * current call stack as a sample. */
+void take_stack_sample(int signal);
+
+/* Starts the CPU time timer that takes samples. Returns if successful. */
+bool start_sample_timer(void);
+
+/* Discards the samples inherited from the parent process, and starts the
+ * timer again (as timers are not inherited), in a newly forked process. */
+void restart_sampling_profiler(void);
+
+/* Stops sampling, and writes the samples taken to the profile file of this
+ * process in the folded stack format. */
+void write_stack_samples(void);
+
+/* Takes in a sample, and a buffer of MAX_FOLDED_STACK_SIZE chars. Writes the
+ * sample's stack to said buffer in the folded format (without a count). */
+void fold_stack_sample(StackSample* sample, char* folded);
+
+/* Takes in two folded stacks (as for qsort()). Returns their order. */
+int compare_folded_stacks(const void* first, const void* second);
+
+#endif
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "2310replay.h"
+#include "2310latency.h"
+#include "dealerErrors.h"
+
+static struct option replayOptions[] = {
+    {"game", required_argument, NULL, 'g'},
+    {"move", required_argument, NULL, 'm'},
+    {NULL, 0, NULL, 0}
+};
+
+int main(int argc, char** argv) {
+    ReplayFrame frame = {.gameNumber = 0, .move = 0};
+    int option;
+    while ((option = getopt_long(argc, argv, "", replayOptions, NULL)) !=
+	    -1) {
+	int* setting = (option == 'g') ? &frame.gameNumber : &frame.move;
+	char* error;
+	long number = (option == '?') ? -1 : strtol(optarg, &error, 10);
+	if (option == '?' || !strlen(optarg) || *error != '\0' ||
+		number < (option == 'g') || number > INT32_MAX) {
+	    fprintf(stderr, REPLAY_USAGE);
+	    return REPLAY_ARGS;
+	}
+	*setting = number;
+    }
+    if (optind == argc || (frame.move && !frame.gameNumber)) {
+	fprintf(stderr, REPLAY_USAGE);
+	return REPLAY_ARGS;
+    }
+
+    ReplayExitCodes replayError = REPLAY_NORMAL;
+    int numGames = 0;
+    long long numMoves = 0;
+    long long startTime = monotonic_time_ns();
+    for (int file = optind; file < argc; file++) {
+	ReplayExitCodes fileError = replay_log_file(argv[file], &frame,
+		&numGames, &numMoves);
+	if (fileError != REPLAY_NORMAL && replayError == REPLAY_NORMAL) {
+	    replayError = fileError;
+	}
+    }
+    double seconds = (double)(monotonic_time_ns() - startTime) /
+	    (NS_PER_US * US_PER_MS * MS_PER_SEC);
+    fprintf(stderr, "Replayed %lld moves of %d games in %.3f s "
+	    "(%.0f moves/s)\n", numMoves, numGames, seconds,
+	    (seconds > 0) ? numMoves / seconds : 0);
+    return replayError;
+}
+
+bool read_log(LogReader* reader, void* buffer, size_t length) {
+    if (reader->length - reader->offset < length) {
+	return false;
+    }
+    // Records are not aligned within the log, hence are copied out
+    memcpy(buffer, reader->data + reader->offset, length);
+    reader->offset += length;
+    return true;
+}
+
+ReplayExitCodes replay_log_file(char* fileName, ReplayFrame* frame,
+	int* numGames, long long* numMoves) {
+    int logFd = open(fileName, O_RDONLY | O_CLOEXEC);
+    struct stat logStat;
+    if (logFd == -1 || fstat(logFd, &logStat)) {
+	fprintf(stderr, "%s: Unable to read log\n", fileName);
+	if (logFd != -1) {
+	    close(logFd);
+	}
+	return REPLAY_FILE;
+    }
+    if (logStat.st_size == 0) {
+	close(logFd);
+	return REPLAY_NORMAL; // Nothing was logged (mmap() would fail)
+    }
+    void* data = mmap(NULL, logStat.st_size, PROT_READ, MAP_PRIVATE, logFd,
+	    0);
+    close(logFd);
+    if (data == MAP_FAILED) {
+	fprintf(stderr, "%s: Unable to read log\n", fileName);
+	return REPLAY_FILE;
+    }
+    // Logs are read once, front to back
+    madvise(data, logStat.st_size, MADV_SEQUENTIAL);
+
+    LogReader reader = {.fileName = fileName, .data = data,
+	    .length = logStat.st_size, .offset = 0};
+    ReplayExitCodes replayError = REPLAY_NORMAL;
+    while (reader.offset < reader.length) {
+	size_t gameStart = reader.offset;
+	ReplayExitCodes gameError = replay_game(&reader, frame, numMoves);
+	if (gameError == REPLAY_CORRUPT || gameError == REPLAY_FILE) {
+	    // The rest of the log cannot be found reliably
+	    fprintf(stderr, (gameError == REPLAY_CORRUPT) ?
+		    "%s: Corrupt log at byte %zu\n" :
+		    "%s: Unable to read log at byte %zu\n", fileName,
+		    gameStart);
+	    replayError = gameError;
+	    break;
+	}
+	(*numGames)++;
+	if (gameError != REPLAY_NORMAL) {
+	    replayError = gameError;
+	}
+    }
+    munmap(data, logStat.st_size);
+    return replayError;
+}
+
+ReplayExitCodes replay_game(LogReader* reader, ReplayFrame* frame,
+	long long* numMoves) {
+    GameLogHeader header;
+    if (!read_log(reader, &header, sizeof(GameLogHeader)) ||
+	    memcmp(header.magic, GAME_LOG_MAGIC, GAME_LOG_MAGIC_SIZE) ||
+	    header.version != GAME_LOG_VERSION ||
+	    header.playerCount == 0 ||
+	    header.pathLength > reader->length - reader->offset) {
+	return REPLAY_CORRUPT;
+    }
+    // The game takes ownership of the path (see free_game())
+    size_t pathSize = INITIAL_BUFFER_SIZE;
+    char* path = (char*)malloc(pathSize * sizeof(char));
+    if (!path) {
+	return REPLAY_FILE;
+    }
+    // The path is validated as the dealer validates a path file, since the
+    // hash only guards against accidental corruption
+    FILE* pathSource = header.pathLength ? fmemopen((char*)reader->data +
+	    reader->offset, header.pathLength, "r") : NULL;
+    bool pathValid = pathSource && validate_path(&path, &pathSize,
+	    pathSource, false) == DEALER_NORMAL &&
+	    strlen(path) == header.pathLength &&
+	    hash_text(path) == header.pathHash;
+    if (pathSource) {
+	fclose(pathSource);
+    }
+    reader->offset += header.pathLength;
+    // Each player program is at least one character (and a terminator)
+    if (!pathValid || header.lineupLength > reader->length - reader->offset ||
+	    header.lineupLength / 2 < header.playerCount) {
+	free(path);
+	return REPLAY_CORRUPT;
+    }
+    reader->offset += header.lineupLength; // Players are not needed
+    int32_t* scores = (int32_t*)malloc(header.playerCount * sizeof(int32_t));
+    if (!scores) {
+	free(path);
+	return REPLAY_FILE;
+    }
+
+    Game* game = init_game(path, header.playerCount);
+    bool showFrame = (int)header.gameNumber == frame->gameNumber;
+    game->displayEnabled = showFrame && frame->move == 0;
+    display_game(game, false);
+    game->displayEnabled = false;
+
+    // The moves are applied as the dealer applied them, straight from the
+    // mapped log
+    GameLogMove record;
+    bool valid = true;
+    for (uint32_t moveNumber = 1; valid && moveNumber <= header.numMoves;
+	    moveNumber++) {
+	valid = read_log(reader, &record, sizeof(GameLogMove));
+	HapDetails move = {.playerID = record.playerID,
+		.newSite = record.newSite,
+		.additionalPoints = record.additionalPoints,
+		.moneyChange = record.moneyChange,
+		.cardDrawn = record.cardDrawn};
+	if (!valid || !logged_move_valid(game, &move)) {
+	    valid = false;
+	    continue;
+	}
+	game->displayEnabled = showFrame && frame->move == (int)moveNumber;
+	process_hap_details(game, &move, false);
+	display_game(game, false);
+	game->displayEnabled = false;
+    }
+    *numMoves += game->numMoves;
+
+    ReplayExitCodes replayError = REPLAY_NORMAL;
+    if (!valid || !read_log(reader, &record, sizeof(GameLogMove)) ||
+	    record.playerID != GAME_LOG_END) {
+	replayError = REPLAY_CORRUPT;
+    } else if (record.newSite != DEALER_NORMAL) {
+	printf("Game %u %s\n", header.gameNumber,
+		dealer_error_text(record.newSite));
+    } else if (!read_log(reader, scores,
+	    header.playerCount * sizeof(int32_t))) {
+	replayError = REPLAY_CORRUPT;
+    } else {
+	printf("Game %u ", header.gameNumber);
+	if (!final_scores_match(game, scores)) {
+	    fprintf(stderr, "Game %u: Scores do not match the log\n",
+		    header.gameNumber);
+	    replayError = REPLAY_MISMATCH;
+	}
+    }
+    free(scores);
+    free_game(game, path);
+    return replayError;
+}
+
+bool logged_move_valid(Game* game, HapDetails* move) {
+    // Only the player whose turn it is may move
+    if (hap_message_number_invalid(game, move->playerID, move->playerID,
+	    MOVE_PLAYER_ID) || move->playerID != calculate_whose_turn(game)) {
+	return false;
+    }
+    // Each component is checked as players check a HAP message, in HAP
+    // order. First component (i.e. Player ID) already checked.
+    int components[NUM_HAP_COMPONENTS] = {move->playerID, move->newSite,
+	    move->additionalPoints, move->moneyChange, move->cardDrawn};
+    for (int i = MOVE_NEW_SITE; i < NUM_HAP_COMPONENTS; i++) {
+	if (hap_message_number_invalid(game, move->playerID, components[i],
+		i)) {
+	    return false;
+	}
+    }
+    return true;
+}
+
+bool final_scores_match(Game* game, int32_t* loggedScores) {
+    calculate_final_scores(game, false);
+    for (int player = 0; player < game->playerCount; player++) {
+	if (game->players[player]->numPoints != loggedScores[player]) {
+	    return false;
+	}
+    }
+    return true;
+}
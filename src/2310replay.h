@@ -0,0 +1,70 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "2310X.h"
+#include "2310gamelog.h"
+
+/* Usage of the replayer. Replays every game in the given logs (written by
+ * the dealer, see GAME_LOG_ENV) without any players, printing each game's
+ * result as the dealer's server mode does (e.g. Game 3 Scores: 4,9) and
+ * checking the final scores against those logged. With --game, the board of
+ * said game is also displayed as it was after the given move (0 for the
+ * initial board, the default). */
+#define REPLAY_USAGE "Usage: 2310replay [--game n [--move m]] log {log}\n"
+
+/* Replay exit codes */
+typedef enum {
+    REPLAY_NORMAL = 0,
+    REPLAY_ARGS = 1,
+    REPLAY_FILE = 2,        // A log could not be read (or memory ran out)
+    REPLAY_CORRUPT = 3,     // A log is truncated or malformed
+    REPLAY_MISMATCH = 4     // Final scores differ from those logged
+} ReplayExitCodes;
+
+/* Board display requested on the command line */
+typedef struct {
+    int gameNumber;         // 0 if no board is displayed
+    int move;
+} ReplayFrame;
+
+/* A log being read */
+typedef struct {
+    char* fileName;
+    const char* data;
+    size_t length;
+    size_t offset;          // Of the next byte to read
+} LogReader;
+
+/* Takes in a log being read, a buffer, and a number of bytes. Copies said
+ * number of bytes from the log into the buffer, advancing past them. Returns
+ * false (copying nothing) if the log ends first. */
+bool read_log(LogReader* reader, void* buffer, size_t length);
+
+/* Takes in the name of a log file, the requested frame, and counts of the
+ * games and moves replayed (which are added to). Memory-maps said log and
+ * replays every game in it. Returns the appropriate exit code. */
+ReplayExitCodes replay_log_file(char* fileName, ReplayFrame* frame,
+	int* numGames, long long* numMoves);
+
+/* Takes in a log being read (at the header of a game), the requested frame,
+ * and a count of the moves replayed (which is added to). Replays said game,
+ * leaving the reader after its log. Returns the appropriate exit code. */
+ReplayExitCodes replay_game(LogReader* reader, ReplayFrame* frame,
+	long long* numMoves);
+
+/* Takes in the game, and the details of a logged move. Returns if said move
+ * is legal, i.e. is by the player whose turn it is, forward to a site on the
+ * path that is not full without skipping a barrier, with non-negative
+ * additional points, drawing a card that exists. */
+bool logged_move_valid(Game* game, HapDetails* move);
+
+/* Takes in a game that is over, and the scores logged for it. Calculates
+ * (and prints) the final scores. Returns if they match those logged. */
+bool final_scores_match(Game* game, int32_t* loggedScores);
+
+#endif
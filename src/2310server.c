@@ -0,0 +1,792 @@
+/* pipe2() is a GNU extension */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "dealerErrors.h"
+#include "2310dealer.h"
+#include "2310server.h"
+#include "2310io.h"
+#include "2310latency.h"
+#include "2310X.h"
+
+/* Global array - Stores the seat of each child process in childrenIDs. */
+ChildSeat* childrenSeats = NULL;
+
+DealerExitCodes run_server(void) {
+    // No games have started yet, so no children need to be tracked
+    setup_signal_handling(0);
+    raise_file_limit();
+
+    Server server;
+    server.epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (server.epollFd == ERROR_RETURN) {
+	return DEALER_PLAYER;
+    }
+    // A file of requests may be read all at once, so is not limited
+    init_line_buffer(&server.requests, SIZE_MAX);
+    server.requestsOpen = true;
+    server.numGamesRequested = 0;
+    server.numTablesOpen = 0;
+    server.startingTables = NULL;
+    server.lastStartingTable = NULL;
+    server.finishedTables = NULL;
+    server.lingeringTables = NULL;
+    // Players inherit the environment, so also know to wait for new games
+    server.poolPlayers = getenv(PERSISTENT_PLAYER_ENV);
+    server.playerPool = NULL;
+    server.numPooledPlayers = 0;
+    server.reportUsage = getenv(LATENCY_REPORT_ENV);
+
+    // Game requests are read as they arrive. Regular files cannot be polled,
+    // in which case every request is read up front.
+    int stdinFlags = fcntl(STDIN_FILENO, F_GETFL);
+    fcntl(STDIN_FILENO, F_SETFL, stdinFlags | O_NONBLOCK);
+    struct epoll_event requestEvent = {.events = EPOLLIN,
+	    .data.ptr = NULL};
+    if (epoll_ctl(server.epollFd, EPOLL_CTL_ADD, STDIN_FILENO,
+	    &requestEvent) == ERROR_RETURN) {
+	handle_game_requests(&server);
+    }
+
+    struct epoll_event events[MAX_SERVER_EVENTS];
+    while (server.requestsOpen || server.numTablesOpen ||
+	    server.lingeringTables) {
+	// Once every game is over, players that are behind are only waited on
+	// for so long
+	bool draining = !server.requestsOpen && !server.numTablesOpen;
+	int numEvents = epoll_wait(server.epollFd, events,
+		MAX_SERVER_EVENTS, draining ? DRAIN_TIMEOUT_MS :
+		time_until_handshake_deadline(&server));
+	if (numEvents == ERROR_RETURN && errno == EINTR) {
+	    continue;
+	} else if (numEvents == ERROR_RETURN || (!numEvents && draining)) {
+	    break;
+	}
+	for (int event = 0; event < numEvents; event++) {
+	    Seat* seat = (Seat*)events[event].data.ptr;
+	    if (!seat) {
+		handle_game_requests(&server);
+		continue;
+	    }
+	    // Both pipes of a seat share its events. Errors are reported to
+	    // both, and handling a pipe that is not ready does no harm.
+	    uint32_t ready = events[event].events;
+	    if ((ready & (EPOLLOUT | EPOLLERR)) && seat->writeWatched) {
+		handle_seat_output(&server, seat);
+	    }
+	    if ((ready & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+		    seat->table->state != TABLE_FINISHED &&
+		    seat->readFd != ERROR_RETURN) {
+		handle_seat_input(&server, seat);
+	    }
+	}
+	expire_handshakes(&server);
+	// No events refer to finished tables any more
+	while (server.finishedTables) {
+	    Table* table = server.finishedTables;
+	    server.finishedTables = table->nextFinished;
+	    free_table(table);
+	}
+	reap_children(&server);
+    }
+    while (server.lingeringTables) {
+	Table* table = server.lingeringTables;
+	server.lingeringTables = table->nextLingering;
+	free_table(table);
+    }
+    close_player_pool(&server);
+    close_zygotes();
+    fcntl(STDIN_FILENO, F_SETFL, stdinFlags);
+    close(server.epollFd);
+    free_line_buffer(&server.requests);
+
+    // Players exit once their pipes are closed, so can now be accounted for
+    if (server.reportUsage) {
+	wait_for_children(&server, REAP_TIMEOUT_MS);
+    }
+    free(childrenIDs);
+    free(childrenSeats);
+    return DEALER_NORMAL;
+}
+
+int time_until_handshake_deadline(Server* server) {
+    if (!server->startingTables) {
+	return -1;
+    }
+    long long timeLeft = server->startingTables->handshakeDeadline -
+	    monotonic_time_ms();
+    return (timeLeft > 0) ? (int)timeLeft : 0;
+}
+
+void expire_handshakes(Server* server) {
+    long long now = monotonic_time_ms();
+    while (server->startingTables &&
+	    server->startingTables->handshakeDeadline <= now) {
+	// Some players never started (finish_table() removes the table)
+	finish_table(server, server->startingTables, DEALER_PLAYER);
+    }
+}
+
+void add_starting_table(Server* server, Table* table) {
+    table->handshakeDeadline = monotonic_time_ms() + HANDSHAKE_TIMEOUT_MS;
+    table->prevStarting = server->lastStartingTable;
+    table->nextStarting = NULL;
+    if (server->lastStartingTable) {
+	server->lastStartingTable->nextStarting = table;
+    } else {
+	server->startingTables = table;
+    }
+    server->lastStartingTable = table;
+}
+
+void remove_starting_table(Server* server, Table* table) {
+    if (table->prevStarting) {
+	table->prevStarting->nextStarting = table->nextStarting;
+    } else {
+	server->startingTables = table->nextStarting;
+    }
+    if (table->nextStarting) {
+	table->nextStarting->prevStarting = table->prevStarting;
+    } else {
+	server->lastStartingTable = table->prevStarting;
+    }
+}
+
+void handle_game_requests(Server* server) {
+    ReadStatus status = fill_line_buffer(&server->requests,
+	    STDIN_FILENO);
+    char* request;
+    while (next_line(&server->requests, &request)) {
+	open_table(server, request);
+    }
+    if (status != READ_MORE) {
+	server->requestsOpen = false;
+	epoll_ctl(server->epollFd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+    }
+}
+
+void open_table(Server* server, char* request) {
+    // Count the arguments, so that they can be split into the dealer's
+    // command-line format, i.e. with the dealer program first and NULL last
+    int numRequestArgs = 0;
+    for (char* arg = request + strspn(request, " \t"); *arg;
+	    arg += strspn(arg, " \t")) {
+	numRequestArgs++;
+	arg += strcspn(arg, " \t");
+    }
+    int argc = 1;
+    char** argv = (char**)malloc((numRequestArgs + 2) * sizeof(char*));
+    argv[0] = "2310dealer";
+    for (char* arg = strtok(request, " \t"); arg;
+	    arg = strtok(NULL, " \t")) {
+	argv[argc++] = arg;
+    }
+    argv[argc] = NULL;
+    if (argc == 1) {
+	free(argv);
+	return; // Blank line, nothing requested
+    }
+    int gameNumber = ++(server->numGamesRequested);
+    char* deck = NULL;
+    char* path = NULL;
+    DealerExitCodes loadError = (numRequestArgs <
+	    MIN_NUM_REQUEST_ARGS) ? DEALER_ARGS :
+	    load_game_files(argv[1], argv[2], &deck, &path);
+    if (loadError != DEALER_NORMAL) {
+	printf("Game %d %s\n", gameNumber, dealer_error_text(loadError));
+	fflush(stdout);
+	free(argv);
+	return;
+    }
+    Table* table = (Table*)malloc(sizeof(Table));
+    table->gameNumber = gameNumber;
+    table->state = TABLE_STARTING;
+    table->deck = deck;
+    table->path = path;
+    // First 3 arguments are the dealer program, and the deck and path files
+    table->playerCount = argc - 3;
+    table->game = init_game(path, table->playerCount);
+    table->game->displayEnabled = false; // Many games share one stdout
+    setup_trusted_mode(table->game, getenv(TRUSTED_DEALER_ENV));
+    table->log = start_game_log(gameNumber, deck, path, table->playerCount,
+	    argv + 3);
+    table->seats = (Seat*)malloc(table->playerCount * sizeof(Seat));
+    table->pluginPlayers = (PluginPlayer**)malloc(table->playerCount *
+	    sizeof(PluginPlayer*));
+    table->pendingHandshakes = 0;
+    table->awaitingMove = INVALID_PLAYER_ID;
+    table->epollFd = server->epollFd;
+    table->nextFinished = NULL;
+
+    // Players must be able to fall behind by the whole path
+    size_t queueLimit = OUTBOUND_QUEUE_LIMIT + strlen(path);
+    for (int player = 0; player < table->playerCount; player++) {
+	Seat* seat = &table->seats[player];
+	seat->table = table;
+	seat->playerID = player;
+	seat->program = NULL;
+	seat->processID = 0;
+	seat->readFd = ERROR_RETURN;
+	seat->writeFd = ERROR_RETURN;
+	seat->handshakeReceived = false;
+	seat->writeWatched = false;
+	init_line_buffer(&seat->inbound, INBOUND_BUFFER_LIMIT);
+	init_outbound_queue(&seat->outbound, queueLimit);
+	table->pluginPlayers[player] = NULL;
+    }
+    server->numTablesOpen++;
+    add_starting_table(server, table);
+    for (int player = 0; player < table->playerCount; player++) {
+	if (!seat_player(server, table, player, argv)) {
+	    free(argv);
+	    finish_table(server, table, DEALER_PLAYER);
+	    return;
+	}
+    }
+    free(argv);
+
+    // A game of only plugin players can start straight away
+    if (!table->pendingHandshakes) {
+	start_table_game(server, table);
+    }
+}
+
+bool seat_player(Server* server, Table* table, int player, char** argv) {
+    // exclude first 3 args of dealer argv (dealer program, deck, and path)
+    if (is_plugin_player(argv[player + 3])) {
+	table->pluginPlayers[player] = load_plugin_player(argv[player + 3]);
+	return table->pluginPlayers[player];
+    }
+    table->seats[player].program = strdup(argv[player + 3]);
+    if (seat_pooled_player(server, table, player, argv[player + 3])) {
+	return true;
+    }
+    // Pipes must not leak into the players of other games
+    int toPlayer[2], fromPlayer[2];
+    if (pipe2(toPlayer, O_CLOEXEC)) {
+	return false;
+    }
+    if (pipe2(fromPlayer, O_CLOEXEC)) {
+	close(toPlayer[READ_END]);
+	close(toPlayer[WRITE_END]);
+	return false;
+    }
+    // exclude first 3 args of dealer argv (dealer program, deck, and path)
+    pid_t processID = spawn_player(toPlayer, fromPlayer, argv[player + 3],
+	    table->playerCount, player);
+    close(toPlayer[READ_END]);
+    close(fromPlayer[WRITE_END]);
+    Seat* seat = &table->seats[player];
+    seat->readFd = fromPlayer[READ_END];
+    seat->writeFd = toPlayer[WRITE_END];
+    if (processID < 0) {
+	return false;
+    }
+    track_child(processID, table->gameNumber, player);
+    seat->processID = processID;
+
+    // A player that stops reading (or writing) must not hold up the server
+    fcntl(seat->readFd, F_SETFL, fcntl(seat->readFd, F_GETFL) | O_NONBLOCK);
+    fcntl(seat->writeFd, F_SETFL, fcntl(seat->writeFd, F_GETFL) |
+	    O_NONBLOCK);
+    struct epoll_event seatEvent = {.events = EPOLLIN, .data.ptr = seat};
+    if (epoll_ctl(server->epollFd, EPOLL_CTL_ADD, seat->readFd, &seatEvent)
+	    == ERROR_RETURN) {
+	return false;
+    }
+    table->pendingHandshakes++;
+    return true;
+}
+
+bool seat_pooled_player(Server* server, Table* table, int player,
+	char* program) {
+    PooledPlayer** pooled = &server->playerPool;
+    while (*pooled) {
+	PooledPlayer* pooledPlayer = *pooled;
+	if (strcmp(pooledPlayer->program, program)) {
+	    pooled = &pooledPlayer->next;
+	    continue;
+	}
+	*pooled = pooledPlayer->next;
+	server->numPooledPlayers--;
+	Seat* seat = &table->seats[player];
+	seat->readFd = pooledPlayer->readFd;
+	seat->writeFd = pooledPlayer->writeFd;
+	seat->processID = pooledPlayer->processID;
+	if (seat->processID > 0) {
+	    track_child(seat->processID, table->gameNumber, player);
+	}
+	free(pooledPlayer->program);
+	free(pooledPlayer);
+
+	// An idle player should not have sent anything (or exited) since its
+	// last game, in which case it cannot be reused
+	struct pollfd idleCheck = {.fd = seat->readFd, .events = POLLIN};
+	struct epoll_event seatEvent = {.events = EPOLLIN, .data.ptr = seat};
+	if (poll(&idleCheck, 1, 0) || epoll_ctl(server->epollFd,
+		EPOLL_CTL_ADD, seat->readFd, &seatEvent) == ERROR_RETURN) {
+	    close(seat->readFd);
+	    close(seat->writeFd);
+	    seat->readFd = ERROR_RETURN;
+	    seat->writeFd = ERROR_RETURN;
+	    continue;
+	}
+	// The player replies with ^, as if it had just been started
+	char newGame[INITIAL_BUFFER_SIZE];
+	int newGameLength = snprintf(newGame, INITIAL_BUFFER_SIZE,
+		"NEWGAME%d,%d\n", table->playerCount, player);
+	send_to_table_player(table, player, newGame, newGameLength);
+	table->pendingHandshakes++;
+	return true;
+    }
+    return false;
+}
+
+void pool_player(Server* server, Seat* seat) {
+    // Only a player that has read everything sent to it, and sent nothing
+    // more than was asked of it, is ready for another game
+    if (!server->poolPlayers || server->numPooledPlayers >=
+	    MAX_POOLED_PLAYERS || !seat->program ||
+	    seat->readFd == ERROR_RETURN || seat->writeFd == ERROR_RETURN ||
+	    seat->writeWatched || seat->inbound.start < seat->inbound.length) {
+	return;
+    }
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, seat->readFd, NULL);
+    PooledPlayer* pooledPlayer = (PooledPlayer*)malloc(sizeof(PooledPlayer));
+    pooledPlayer->program = strdup(seat->program);
+    pooledPlayer->readFd = seat->readFd;
+    pooledPlayer->writeFd = seat->writeFd;
+    pooledPlayer->processID = seat->processID;
+    pooledPlayer->next = server->playerPool;
+    server->playerPool = pooledPlayer;
+    server->numPooledPlayers++;
+    seat->readFd = ERROR_RETURN;
+    seat->writeFd = ERROR_RETURN;
+    seat->processID = 0; // Now belongs to the pool
+}
+
+void close_player_pool(Server* server) {
+    // Pooled players see EOF instead of NEWGAME, and exit
+    while (server->playerPool) {
+	PooledPlayer* pooledPlayer = server->playerPool;
+	server->playerPool = pooledPlayer->next;
+	close(pooledPlayer->readFd);
+	close(pooledPlayer->writeFd);
+	free(pooledPlayer->program);
+	free(pooledPlayer);
+    }
+    server->numPooledPlayers = 0;
+}
+
+void handle_seat_input(Server* server, Seat* seat) {
+    Table* table = seat->table;
+    ReadStatus status = fill_line_buffer(&seat->inbound, seat->readFd);
+    if (status == READ_OVERFLOW) {
+	// A player sending more than it is asked for is dropped, rather than
+	// buffered without bound
+	finish_table(server, table, (table->state == TABLE_STARTING) ?
+		DEALER_PLAYER : DEALER_COMMUNICATION);
+	return;
+    }
+    if (status != READ_MORE) {
+	// Anything already received from the player may still be used
+	close(seat->readFd);
+	seat->readFd = ERROR_RETURN;
+    }
+
+    if (!seat->handshakeReceived) {
+	int handshake = next_char(&seat->inbound);
+	if (handshake == EOF && status == READ_MORE) {
+	    return; // Nothing received yet
+	}
+	// Successful starting of players should ensure all players return a
+	// ^
+	if (handshake != '^') {
+	    finish_table(server, table, DEALER_PLAYER);
+	    return;
+	}
+	seat->handshakeReceived = true;
+	if (!--(table->pendingHandshakes)) {
+	    start_table_game(server, table);
+	}
+	return;
+    }
+    // Only the player whose turn it is should be sending anything. Other
+    // players are dealt with once it is their turn.
+    if (table->awaitingMove == seat->playerID) {
+	advance_table(server, table);
+    }
+}
+
+void handle_seat_output(Server* server, Seat* seat) {
+    // Once everything waiting has been written (or the player has gone),
+    // there is no need to know when the pipe is writable
+    flush_outbound_queue(&seat->outbound, seat->writeFd);
+    if (outbound_pending(&seat->outbound)) {
+	return;
+    }
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, seat->writeFd, NULL);
+    seat->writeWatched = false;
+
+    // The pipes of a finished game stay open only until its players catch up
+    Table* table = seat->table;
+    if (table->state == TABLE_FINISHED) {
+	close(seat->writeFd);
+	seat->writeFd = ERROR_RETURN;
+	if (!--(table->numLingering)) {
+	    Table** lingering = &server->lingeringTables;
+	    while (*lingering != table) {
+		lingering = &(*lingering)->nextLingering;
+	    }
+	    *lingering = table->nextLingering;
+	    retire_table(server, table);
+	}
+    }
+}
+
+void start_table_game(Server* server, Table* table) {
+    remove_starting_table(server, table);
+    table->state = TABLE_PLAYING;
+    // The path is followed by the announcement of trusted mode, if enabled
+    size_t pathLength = strlen(table->path);
+    char* pathMessage = (char*)malloc((pathLength + INITIAL_BUFFER_SIZE) *
+	    sizeof(char));
+    int messageLength = sprintf(pathMessage, "%s\n", table->path);
+    if (table->game->trustedDealer) {
+	sprintf(pathMessage + messageLength, "TRUST%d\n",
+		table->game->checksumPeriod);
+    }
+    bool pathSent = send_to_table(table, pathMessage);
+    free(pathMessage);
+    if (!pathSent) {
+	finish_table(server, table, DEALER_COMMUNICATION);
+	return;
+    }
+
+    for (int player = 0; player < table->playerCount; player++) {
+	PluginPlayer* pluginPlayer = table->pluginPlayers[player];
+	if (pluginPlayer && !start_plugin_player(pluginPlayer, table->path,
+		table->playerCount, player, NULL)) {
+	    finish_table(server, table, DEALER_COMMUNICATION);
+	    return;
+	}
+    }
+    advance_table(server, table);
+}
+
+void advance_table(Server* server, Table* table) {
+    Game* game = table->game;
+    while (!is_game_over(game)) {
+	int whoseTurn = calculate_whose_turn(game);
+	Seat* seat = &table->seats[whoseTurn];
+	PluginPlayer* pluginPlayer = table->pluginPlayers[whoseTurn];
+	char pluginDo[INITIAL_BUFFER_SIZE];
+	char* getDo = pluginDo;
+
+	if (pluginPlayer) {
+	    // Ask the plugin for its move directly, as in the usual mode
+	    int pluginMove = pluginPlayer->plugin->moveStrategy(
+		    pluginPlayer->game,
+		    pluginPlayer->game->players[whoseTurn]);
+	    snprintf(pluginDo, INITIAL_BUFFER_SIZE, "DO%d", pluginMove);
+	} else {
+	    // Ask the player whose turn it is to send back a move, unless
+	    // this has already been done
+	    if (table->awaitingMove != whoseTurn) {
+		table->awaitingMove = whoseTurn;
+		if (!send_to_table_player(table, whoseTurn, "YT\n",
+			strlen("YT\n"))) {
+		    finish_table(server, table, DEALER_COMMUNICATION);
+		    return;
+		}
+	    }
+	    if (!next_line(&seat->inbound, &getDo)) {
+		// Wait for the move, unless it can never arrive
+		if (seat->readFd == ERROR_RETURN) {
+		    finish_table(server, table, DEALER_COMMUNICATION);
+		}
+		return;
+	    }
+	    table->awaitingMove = INVALID_PLAYER_ID;
+	}
+	if (!apply_table_move(table, whoseTurn, getDo)) {
+	    finish_table(server, table, DEALER_COMMUNICATION);
+	    return;
+	}
+    }
+    finish_table(server, table, DEALER_NORMAL);
+}
+
+bool apply_table_move(Table* table, int movingPlayer, char* doMessage) {
+    Game* game = table->game;
+
+    // Dealer should only receive (valid) DO messages
+    HapDetails move;
+    if (decode_message(game, game->players[movingPlayer], doMessage, &move)
+	    != MESSAGE_DO) {
+	return false;
+    }
+    // Form the required HAP message and update game details, so that the
+    // next player to move is known before the HAP is sent
+    char messages[TURN_MESSAGES_SIZE];
+    int messagesLength = create_hap_message(game, &move, table->deck,
+	    messages);
+    log_game_move(table->log, &move);
+    process_hap_details(game, &move, false);
+    for (int player = 0; player < table->playerCount; player++) {
+	if (table->pluginPlayers[player]) {
+	    // Keep the plugin player's game up to date
+	    process_hap_details(table->pluginPlayers[player]->game, &move,
+		    true);
+	}
+    }
+    int nextMover = is_game_over(game) ? INVALID_PLAYER_ID :
+	    calculate_whose_turn(game);
+
+    // Every player is sent the HAP, followed by a SUM if due (to let
+    // trusting players check that their game state matches). The next player
+    // to move is also sent YT in the same write.
+    if (checksum_due(game)) {
+	messagesLength += sprintf(messages + messagesLength, "SUM%u\n",
+		calculate_game_checksum(game));
+    }
+    int ytLength = sprintf(messages + messagesLength, "YT\n");
+    bool sent = true;
+    for (int player = 0; player < table->playerCount; player++) {
+	if (!send_to_table_player(table, player, messages, messagesLength +
+		(player == nextMover ? ytLength : 0))) {
+	    sent = false;
+	}
+    }
+    if (nextMover != INVALID_PLAYER_ID &&
+	    !table->pluginPlayers[nextMover]) {
+	table->awaitingMove = nextMover;
+    }
+
+    // A player that has fallen too far behind cannot keep playing
+    return sent;
+}
+
+bool send_to_table_player(Table* table, int player, const char* message,
+	size_t messageLength) {
+    Seat* seat = &table->seats[player];
+    // Plugin players have no pipes
+    if (seat->writeFd == ERROR_RETURN) {
+	return true;
+    }
+    // A player that has gone is found out when it is next asked to move, so
+    // only a player that has fallen too far behind is an error here
+    if (queue_message(&seat->outbound, seat->writeFd, message,
+	    messageLength) == WRITE_OVERFLOW) {
+	return false;
+    }
+    // Write the rest once the player catches up
+    if (outbound_pending(&seat->outbound) && !seat->writeWatched) {
+	struct epoll_event seatEvent = {.events = EPOLLOUT,
+		.data.ptr = seat};
+	epoll_ctl(table->epollFd, EPOLL_CTL_ADD, seat->writeFd, &seatEvent);
+	seat->writeWatched = true;
+    }
+    return true;
+}
+
+bool send_to_table(Table* table, char* message) {
+    bool sent = true;
+    for (int player = 0; player < table->playerCount; player++) {
+	if (!send_to_table_player(table, player, message, strlen(message))) {
+	    sent = false;
+	}
+    }
+    return sent;
+}
+
+void finish_table(Server* server, Table* table, DealerExitCodes gameError) {
+    if (gameError == DEALER_NORMAL) {
+	send_to_table(table, "DONE\n");
+	printf("Game %d ", table->gameNumber);
+	calculate_final_scores(table->game, false);
+    } else {
+	// Players that failed to start are never told the path, so are not
+	// told the game is over either
+	if (table->state == TABLE_PLAYING) {
+	    send_to_table(table, "EARLY\n");
+	}
+	printf("Game %d %s\n", table->gameNumber,
+		dealer_error_text(gameError));
+    }
+    fflush(stdout);
+    if (table->state == TABLE_STARTING) {
+	remove_starting_table(server, table);
+    }
+    if (!finish_game_log(table->log, gameError == DEALER_NORMAL ?
+	    table->game : NULL, gameError)) {
+	fprintf(stderr, "Game %d: Unable to write game log to %s\n",
+		table->gameNumber, getenv(GAME_LOG_ENV));
+    }
+
+    // Closing the pipes also removes them from the epoll instance. Pipes to
+    // players that are behind stay open until they catch up.
+    table->numLingering = 0;
+    for (int player = 0; player < table->playerCount; player++) {
+	Seat* seat = &table->seats[player];
+	if (gameError == DEALER_NORMAL) {
+	    pool_player(server, seat);
+	}
+	if (seat->readFd != ERROR_RETURN) {
+	    close(seat->readFd);
+	    seat->readFd = ERROR_RETURN;
+	}
+	if (seat->writeWatched) {
+	    table->numLingering++;
+	} else if (seat->writeFd != ERROR_RETURN) {
+	    close(seat->writeFd);
+	    seat->writeFd = ERROR_RETURN;
+	}
+    }
+    table->state = TABLE_FINISHED;
+    server->numTablesOpen--;
+    if (table->numLingering) {
+	table->nextLingering = server->lingeringTables;
+	server->lingeringTables = table;
+    } else {
+	retire_table(server, table);
+    }
+}
+
+void retire_table(Server* server, Table* table) {
+    table->nextFinished = server->finishedTables;
+    server->finishedTables = table;
+}
+
+void free_table(Table* table) {
+    for (int player = 0; player < table->playerCount; player++) {
+	// Players that never caught up lose their remaining messages
+	if (table->seats[player].writeFd != ERROR_RETURN) {
+	    close(table->seats[player].writeFd);
+	}
+	// Players forked by zygotes are not children of the server, so are
+	// never reaped by it. Any other player is tracked until reaped.
+	siginfo_t childInfo;
+	if (waitid(P_PID, table->seats[player].processID, &childInfo,
+		WEXITED | WNOHANG | WNOWAIT) == ERROR_RETURN &&
+		errno == ECHILD) {
+	    untrack_child(table->seats[player].processID);
+	}
+	free(table->seats[player].program);
+	free_line_buffer(&table->seats[player].inbound);
+	free_outbound_queue(&table->seats[player].outbound);
+    }
+    free_plugin_players(table->pluginPlayers, table->playerCount);
+    free_game(table->game, table->path);
+    free(table->seats);
+    free(table->deck);
+    free(table);
+}
+
+void track_child(pid_t childID, int gameNumber, int playerID) {
+    // Prevent the SIGHUP handler from seeing a partially updated array
+    sigset_t sighupMask, previousMask;
+    sigemptyset(&sighupMask);
+    sigaddset(&sighupMask, SIGHUP);
+    sigprocmask(SIG_BLOCK, &sighupMask, &previousMask);
+
+    // Reuse the child's own slot if it is already tracked (i.e. pooled),
+    // otherwise the first free slot
+    int child = 0;
+    while (child < numChildren && childrenIDs[child] != childID) {
+	child++;
+    }
+    if (child == numChildren) {
+	child = 0;
+	while (child < numChildren && childrenIDs[child] > 0) {
+	    child++;
+	}
+    }
+    if (child == numChildren) {
+	int newNumChildren = numChildren * RESIZING_FACTOR + 1;
+	childrenIDs = (pid_t*)realloc(childrenIDs, newNumChildren *
+		sizeof(pid_t));
+	childrenSeats = (ChildSeat*)realloc(childrenSeats, newNumChildren *
+		sizeof(ChildSeat));
+	for (int unused = numChildren; unused < newNumChildren; unused++) {
+	    childrenIDs[unused] = 0;
+	}
+	numChildren = newNumChildren;
+    }
+    childrenIDs[child] = childID;
+    childrenSeats[child].gameNumber = gameNumber;
+    childrenSeats[child].playerID = playerID;
+    sigprocmask(SIG_SETMASK, &previousMask, NULL);
+}
+
+void untrack_child(pid_t childID) {
+    if (childID <= 0) {
+	return;
+    }
+    // The SIGHUP handler only reads the array, so a single slot may be
+    // cleared without blocking it
+    for (int child = 0; child < numChildren; child++) {
+	if (childrenIDs[child] == childID) {
+	    childrenIDs[child] = 0;
+	    break;
+	}
+    }
+}
+
+void reap_children(Server* server) {
+    struct rusage usage;
+    pid_t childID;
+    while ((childID = wait4(-1, NULL, WNOHANG, &usage)) > 0) {
+	for (int child = 0; child < numChildren; child++) {
+	    if (childrenIDs[child] != childID) {
+		continue;
+	    }
+	    childrenIDs[child] = 0;
+	    if (server->reportUsage) {
+		char label[LATENCY_LABEL_SIZE];
+		snprintf(label, LATENCY_LABEL_SIZE, "Game %d Player %d",
+			childrenSeats[child].gameNumber,
+			childrenSeats[child].playerID);
+		print_usage_summary(stderr, label, &usage);
+		fflush(stderr);
+	    }
+	    break;
+	}
+    }
+}
+
+void wait_for_children(Server* server, int timeout) {
+    long long deadline = monotonic_time_ms() + timeout;
+    while (monotonic_time_ms() < deadline) {
+	reap_children(server);
+	bool waiting = false;
+	for (int child = 0; child < numChildren && !waiting; child++) {
+	    waiting = childrenIDs[child] > 0;
+	}
+	if (!waiting) {
+	    break;
+	}
+	// The server has no SIGCHLD handler to wake it, so check back shortly
+	poll(NULL, 0, 1);
+    }
+}
+
+void raise_file_limit(void) {
+    struct rlimit fileLimit;
+    if (!getrlimit(RLIMIT_NOFILE, &fileLimit)) {
+	fileLimit.rlim_cur = fileLimit.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &fileLimit);
+    }
+}
@@ -0,0 +1,288 @@
+#ifndef DEALER_SERVER_H
+#define DEALER_SERVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include "dealerErrors.h"
+#include "2310dealer.h"
+#include "2310io.h"
+#include "2310X.h"
+
+/* Command-line argument that starts the dealer in server mode, i.e.
+ * 2310dealer --server. Each line of stdin then requests a game, in the same
+ * format as the dealer's usual command-line arguments (deck path p1 {p2}).
+ * Games are numbered from 1 in the order they are requested, and each
+ * finished game prints a single line to stdout: "Game n " followed by either
+ * the final scores or the dealer error message. */
+#define SERVER_MODE_ARG "--server"
+
+/* Maximum number of events handled per call to epoll_wait(). */
+#define MAX_SERVER_EVENTS 64
+
+/* A game request line holds the deck, the path, and at least one player. */
+#define MIN_NUM_REQUEST_ARGS (MIN_NUM_CMD_LINE_ARGS - 1)
+
+/* Maximum number of idle player processes kept for reuse (only when players
+ * are pooled, see PERSISTENT_PLAYER_ENV). */
+#define MAX_POOLED_PLAYERS 256
+
+/* Table States */
+typedef enum {
+    TABLE_STARTING = 0,     // Waiting for each player's ^
+    TABLE_PLAYING = 1,      // Path has been sent, game in progress
+    TABLE_FINISHED = 2      // Game over, waiting to be freed
+} TableState;
+
+struct Table;
+
+/* The game and player that a tracked child process was started for, so that
+ * it can be accounted for once it exits (even after its table is freed). */
+typedef struct {
+    int gameNumber;
+    int playerID;
+} ChildSeat;
+
+/* Global array - Stores the seat of each child process in childrenIDs (in
+ * server mode). */
+extern ChildSeat* childrenSeats;
+
+/* Seat representation (one player of a hosted game) */
+typedef struct {
+    struct Table* table;
+    int playerID;
+
+    // Player program (NULL if the player is a plugin), kept so that the
+    // process can be pooled once the game is over, and the PID of the
+    // process started for this seat (0 if none was)
+    char* program;
+    pid_t processID;
+
+    // Pipes to and from the player process, or -1 if the player is a plugin
+    // (or the pipe has been closed)
+    int readFd;
+    int writeFd;
+
+    // Data received from the player that has not been processed yet
+    LineBuffer inbound;
+    bool handshakeReceived;
+
+    // Messages waiting until the player catches up, and whether the write
+    // pipe is registered with the epoll instance (only while they wait)
+    OutboundQueue outbound;
+    bool writeWatched;
+} Seat;
+
+/* Table representation (a game hosted by the server). Equivalent to the
+ * state that the dealer keeps for its one game in the usual mode. */
+typedef struct Table {
+    int gameNumber;
+    TableState state;
+    char* deck;
+    char* path;
+    Game* game;
+    int playerCount;
+    Seat* seats;
+
+    // Plugin players (NULL for players that are processes)
+    PluginPlayer** pluginPlayers;
+
+    // Log of the game (NULL if games are not logged, see GAME_LOG_ENV)
+    GameLog* log;
+
+    // Number of player processes yet to send their ^
+    int pendingHandshakes;
+
+    // The player that has been sent YT and not yet replied, if any
+    int awaitingMove;
+
+    // When the table gives up on players yet to send their ^, and its
+    // neighbours in the list of tables waiting on handshakes
+    long long handshakeDeadline;
+    struct Table* prevStarting;
+    struct Table* nextStarting;
+
+    // The server's epoll instance, which the pipes are registered with
+    int epollFd;
+
+    // Number of players of a finished game still being sent their remaining
+    // messages
+    int numLingering;
+
+    // Next table in the list of finished tables waiting to be freed, and in
+    // the list of finished tables with lingering players
+    struct Table* nextFinished;
+    struct Table* nextLingering;
+} Table;
+
+/* Pooled player representation (an idle player process waiting for its next
+ * game) */
+typedef struct PooledPlayer {
+    char* program;
+    pid_t processID;
+    int readFd;
+    int writeFd;
+    struct PooledPlayer* next;
+} PooledPlayer;
+
+/* Server representation */
+typedef struct {
+    int epollFd;
+
+    // Game requests read from stdin, and if stdin is yet to reach EOF
+    LineBuffer requests;
+    bool requestsOpen;
+
+    int numGamesRequested;
+    int numTablesOpen;
+
+    // Tables waiting on handshakes. Every table is given as long, so the
+    // list (in order of opening) is also in order of deadline.
+    Table* startingTables;
+    Table* lastStartingTable;
+
+    // Tables finished while handling the current batch of events. These are
+    // freed once the batch is handled, as later events may refer to them.
+    Table* finishedTables;
+
+    // Finished tables whose players are yet to read their remaining messages
+    Table* lingeringTables;
+
+    // Whether player processes are reused across games, and the idle ones
+    bool poolPlayers;
+    PooledPlayer* playerPool;
+    int numPooledPlayers;
+
+    // Whether the resource usage of each player process is reported once it
+    // exits (see LATENCY_REPORT_ENV)
+    bool reportUsage;
+} Server;
+
+/* Entry point for server mode. Hosts every game requested on stdin in this
+ * one process, multiplexing all player pipes on a single epoll instance.
+ * Returns the appropriate dealer exit code once stdin is closed and every
+ * game has finished. */
+DealerExitCodes run_server(void);
+
+/* Takes in the server representation. Reads all available game requests
+ * from stdin and opens a table for each. */
+void handle_game_requests(Server* server);
+
+/* Takes in the server representation. Returns how long epoll_wait() may
+ * wait before the earliest handshake deadline passes (in milliseconds), or
+ * -1 if no table is waiting on handshakes. */
+int time_until_handshake_deadline(Server* server);
+
+/* Takes in the server representation. Fails every table whose handshake
+ * deadline has passed, as the dealer does when its players fail to start. */
+void expire_handshakes(Server* server);
+
+/* Takes in the server representation and a newly opened table. Starts the
+ * handshake deadline of said table. */
+void add_starting_table(Server* server, Table* table);
+
+/* Takes in the server representation and a table that is no longer waiting
+ * on handshakes. Removes said table from the list of starting tables. */
+void remove_starting_table(Server* server, Table* table);
+
+/* Takes in the server representation and a game request line. Loads the
+ * deck and path, and seats the players of the requested game. */
+void open_table(Server* server, char* request);
+
+/* Takes in the server representation, the table, the player ID, and the
+ * request arguments (in the dealer's command-line argument format). Loads
+ * the plugin or starts the process of said player. Returns if successful. */
+bool seat_player(Server* server, Table* table, int player, char** argv);
+
+/* Takes in the server representation, the table, the player ID and the
+ * player program. Seats an idle pooled process of said program, if there is
+ * one, and starts its next game by sending it NEWGAME. Returns if a pooled
+ * process was seated. */
+bool seat_pooled_player(Server* server, Table* table, int player,
+	char* program);
+
+/* Takes in the server representation and a seat of a game that has just
+ * finished normally. Adds the process of said seat to the player pool
+ * (instead of closing its pipes) if it is in a state to play again. */
+void pool_player(Server* server, Seat* seat);
+
+/* Takes in the server representation. Closes the pipes of every pooled
+ * player, letting them exit. */
+void close_player_pool(Server* server);
+
+/* Takes in the server representation and a seat whose pipe is readable.
+ * Reads from the player and progresses the table accordingly. */
+void handle_seat_input(Server* server, Seat* seat);
+
+/* Takes in the server representation and a seat whose pipe to the player is
+ * writable. Writes any messages waiting to be sent to said player. */
+void handle_seat_output(Server* server, Seat* seat);
+
+/* Takes in the server representation and a table whose players have all
+ * started. Sends the path to each player and begins the game. */
+void start_table_game(Server* server, Table* table);
+
+/* Takes in the server representation and a table. Plays as many moves of the
+ * game as possible without waiting, i.e. until the player whose turn it is
+ * has not replied yet, or the game is over. */
+void advance_table(Server* server, Table* table);
+
+/* Takes in the table, the player ID of the moving player and the message they
+ * sent. Validates the move, updates the game and sends the resulting HAP
+ * message to every player, along with the YT for the next player to move.
+ * Returns if the move was valid. */
+bool apply_table_move(Table* table, int movingPlayer, char* doMessage);
+
+/* Takes in a table, a player ID and a message of the given length. Sends (or
+ * queues) said message to said player, if they are a player process whose
+ * pipe is still open. Returns false if the player has fallen too far behind
+ * to queue it. */
+bool send_to_table_player(Table* table, int player, const char* message,
+	size_t messageLength);
+
+/* Takes in a table and a message. Sends said message to every player process
+ * at said table, and returns false if any player has fallen too far behind.
+ * */
+bool send_to_table(Table* table, char* message);
+
+/* Takes in the server representation, the table, and the dealer exit code
+ * the game ended with. Notifies the players, displays the result and closes
+ * the pipes of said table (except those to players yet to read all their
+ * messages, which are closed once they catch up or the server exits). */
+void finish_table(Server* server, Table* table, DealerExitCodes gameError);
+
+/* Takes in the server representation and a finished table. Adds said table
+ * to the tables to be freed once the current batch of events is handled. */
+void retire_table(Server* server, Table* table);
+
+/* Takes in a finished table. Frees all memory associated with it. */
+void free_table(Table* table);
+
+/* Takes in the PID of a child process, and the game number and player ID it
+ * is (now) playing as. Stores it, so that it may be killed on SIGHUP and
+ * accounted for once it exits. A child already tracked has its seat updated.
+ * */
+void track_child(pid_t childID, int gameNumber, int playerID);
+
+/* Takes in the PID of a started player process (or 0 for none). Stops
+ * tracking it, if it is still tracked. */
+void untrack_child(pid_t childID);
+
+/* Takes in the server representation. Reaps any child processes that have
+ * exited, and stops tracking them. Reports the resource usage of each (as
+ * the player of the game it was last seated at) if requested. */
+void reap_children(Server* server);
+
+/* Takes in the server representation and the longest time to wait (in
+ * milliseconds). Waits until every tracked child process has been reaped, or
+ * the time runs out. */
+void wait_for_children(Server* server, int timeout);
+
+/* Raises the limit on open file descriptors as far as allowed, as every
+ * hosted player uses two. */
+void raise_file_limit(void);
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "2310trace.h"
+#include "2310latency.h"
+#include "2310X.h"
+
+/* Global variable - whether a trace is being recorded. */
+bool tracing = false;
+
+/* Global variable - the trace being recorded, if any. */
+Trace trace;
+
+void start_trace(char* fileName, int playerCount) {
+    if (!fileName) {
+	return;
+    }
+    trace.size = INITIAL_TRACE_SPANS;
+    trace.spans = (TraceSpan*)malloc(trace.size * sizeof(TraceSpan));
+    trace.numSpans = 0;
+    trace.fileName = fileName;
+    trace.playerCount = playerCount;
+    trace.origin = monotonic_time_ns();
+    tracing = true;
+}
+
+void record_span(const char* name, int player, long long start,
+	long long end) {
+    if (trace.numSpans == trace.size) {
+	size_t newSize = (size_t)(trace.size * RESIZING_FACTOR) + 1;
+	TraceSpan* newSpans = (TraceSpan*)realloc(trace.spans,
+		newSize * sizeof(TraceSpan));
+	if (!newSpans) {
+	    return; // The span is left out of the trace
+	}
+	trace.spans = newSpans;
+	trace.size = newSize;
+    }
+    TraceSpan* span = &trace.spans[trace.numSpans++];
+    span->name = name;
+    span->player = player;
+    span->start = start;
+    span->end = end;
+}
+
+bool write_trace(void) {
+    if (!tracing) {
+	return true;
+    }
+    tracing = false;
+    FILE* traceFile = fopen(trace.fileName, "w");
+    if (!traceFile) {
+	free(trace.spans);
+	return false;
+    }
+    // Each player is shown as a thread of the dealer process, after the
+    // dealer's own thread (thread 0)
+    int processID = getpid();
+    fprintf(traceFile, "{\"traceEvents\":[\n");
+    fprintf(traceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+	    "\"tid\":0,\"args\":{\"name\":\"Dealer\"}}", processID);
+    for (int player = 0; player < trace.playerCount; player++) {
+	fprintf(traceFile, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+		"\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"Player %d\"}}",
+		processID, player + 1, player);
+    }
+    // Times are in microseconds since tracing started
+    for (size_t i = 0; i < trace.numSpans; i++) {
+	TraceSpan* span = &trace.spans[i];
+	fprintf(traceFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,"
+		"\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", span->name, processID,
+		span->player + 1, (span->start - trace.origin) / NS_PER_US,
+		(span->end - span->start) / NS_PER_US);
+    }
+    fprintf(traceFile, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    free(trace.spans);
+    return !fclose(traceFile);
+}
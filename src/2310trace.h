@@ -0,0 +1,80 @@
+#ifndef DEALER_TRACE_H
+#define DEALER_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "2310latency.h"
+
+/* If this environment variable is set, the dealer records a timeline of the
+ * game (player start up, each move and the dealer's processing of it, and so
+ * on) and writes it to the file it names once the game is over, in the
+ * Chrome trace event format (viewable in chrome://tracing or Perfetto). */
+#define TRACE_FILE_ENV "DEALER_TRACE"
+
+/* Spans recorded by the dealer itself, rather than for a player, are given
+ * this player ID. */
+#define TRACE_DEALER (-1)
+
+/* Number of spans the trace buffer initially holds (grown as needed). */
+#define INITIAL_TRACE_SPANS 4096
+
+/* Takes in the name of a span, the player ID it belongs to (or
+ * TRACE_DEALER), and its start and end times (from monotonic_time_ns()).
+ * Records said span if tracing. Otherwise, only tests the tracing flag, as
+ * the end time is not evaluated. */
+#define TRACE_SPAN(name, player, start, end) do { \
+	if (tracing) { \
+	    record_span((name), (player), (start), (end)); \
+	} \
+    } while (0)
+
+/* Returns the current time for the start of a span, if tracing. */
+#define TRACE_START() (tracing ? monotonic_time_ns() : 0)
+
+/* A timed part of the game. Names are string literals. */
+typedef struct {
+    const char* name;
+    int player;
+    long long start;
+    long long end;
+} TraceSpan;
+
+/* Trace buffer. Spans are only ever appended, by the dealer's one thread, so
+ * no locking is needed. */
+typedef struct {
+    TraceSpan* spans;
+    size_t numSpans;
+    size_t size;
+
+    // File the trace is written to, the player count, and when tracing
+    // started (the trace's time 0)
+    char* fileName;
+    int playerCount;
+    long long origin;
+} Trace;
+
+/* Global variable - whether a trace is being recorded. */
+extern bool tracing;
+
+/* Global variable - the trace being recorded, if any. */
+extern Trace trace;
+
+/* Takes in the name of the file to write the trace to (or NULL to not
+ * trace), and the player count. Starts recording a trace if given a file. */
+void start_trace(char* fileName, int playerCount);
+
+/* Takes in the name of a span, its player ID (or TRACE_DEALER), and its start
+ * and end times. Adds said span to the trace buffer. Should only be called
+ * (via TRACE_SPAN()) while tracing. */
+void record_span(const char* name, int player, long long start,
+	long long end);
+
+/* Writes the recorded trace to its file, in the Chrome trace event format,
+ * and stops tracing. Returns false if the file could not be written. Does
+ * nothing (and returns true) if not tracing. */
+bool write_trace(void);
+
+#endif
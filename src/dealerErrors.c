@@ -2,12 +2,20 @@
 #include "dealerErrors.h"
 
 DealerExitCodes dealer_error_message(DealerExitCodes dealerExitType) {
-    // The dealer error message to be fprinted to stderr
+    if (dealerExitType == DEALER_NORMAL) {
+	return DEALER_NORMAL;
+    }
+    fprintf(stderr, "%s\n", dealer_error_text(dealerExitType));
+    return dealerExitType;
+}
+
+const char* dealer_error_text(DealerExitCodes dealerExitType) {
+    // The dealer error message (empty for a normal exit)
     const char* dealerErrorMessage = "";
 
     switch (dealerExitType) {
 	case DEALER_NORMAL:
-	    return DEALER_NORMAL;
+	    break;
 	case DEALER_ARGS:
 	    dealerErrorMessage = "Usage: 2310dealer deck path p1 {p2}";
 	    break;	
@@ -23,8 +31,9 @@ DealerExitCodes dealer_error_message(DealerExitCodes dealerExitType) {
 	case DEALER_COMMUNICATION:
 	    dealerErrorMessage = "Communications error";
 	    break;
+	case DEALER_CHECKPOINT:
+	    dealerErrorMessage = "Error reading checkpoint";
+	    break;
     }
-
-    fprintf(stderr, "%s\n", dealerErrorMessage);
-    return dealerExitType;
+    return dealerErrorMessage;
 }
@@ -13,11 +13,16 @@ typedef enum {
     DEALER_DECK = 2,
     DEALER_PATH = 3,
     DEALER_PLAYER = 4,
-    DEALER_COMMUNICATION = 5
+    DEALER_COMMUNICATION = 5,
+    DEALER_CHECKPOINT = 6
 } DealerExitCodes;
 
 /* Takes in the dealer exit code. Returns the dealer exit code and displays
  * the respective dealer error message. */
 DealerExitCodes dealer_error_message(DealerExitCodes dealerExitType);
 
+/* Takes in the dealer exit code. Returns the respective dealer error message
+ * (without displaying it). */
+const char* dealer_error_text(DealerExitCodes dealerExitType);
+
 #endif